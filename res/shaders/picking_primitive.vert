@@ -10,8 +10,11 @@ uniform mat4 camMatrix;
 uniform mat4 model;
 uniform mat4 transformation;
 
-const int MAX_BONES = 100;
-uniform mat4 gBones[MAX_BONES];
+// bones palette uploaded once per pose
+layout (std430, binding = 0) readonly buffer BoneMatrices
+{
+    mat4 gBones[];
+};
 
 void main()
 {
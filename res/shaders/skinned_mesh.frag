@@ -12,9 +12,14 @@ in vec3 Normal;
 // Imports the current position from the Vertex Shader
 in vec3 crntPos;
 
-// Gets the Texture Unit from the main function
-uniform sampler2D diffuse0;
-uniform mat3 uv_transformation0;
+// material textures are bound to fixed texture units
+layout (binding = 0) uniform sampler2D diffuse0;
+// material data bound from the mesh's material buffer
+layout (std140, binding = 0) uniform Material
+{
+    // one per diffuse texture unit, MAX_DIFFUSE_TEXTURES in material.h
+    mat3 uv_transformation[4];
+};
 
 uniform sampler2D specular0;
 // Gets the color of the light from the main function
@@ -103,7 +108,7 @@ vec4 spotLight(vec2 uvTransformed)
 
 void main()
 {
-    vec2 uvTransformed = (uv_transformation0 * vec3(texCoord.xy, 1)).xy;
+    vec2 uvTransformed = (uv_transformation[0] * vec3(texCoord.xy, 1)).xy;
 
 	FragColor = direcLight(uvTransformed);
 	//FragColor = spotLight(uvTransformed);
@@ -26,30 +26,112 @@ uniform mat4 camMatrix;
 uniform mat4 model;
 uniform mat4 transformation;
 
-const int MAX_BONES = 100;
-uniform mat4 gBones[MAX_BONES];
+// bones palette uploaded once per pose, every bone keeps the first three rows
+// of its affine transformation as the columns of a mat3x4
+layout (std430, binding = 0) readonly buffer BoneMatrices
+{
+    mat3x4 gBones[];
+};
+
+// bones as dual quaternions, first column is the rotation and second the dual
+// part, both as (x, y, z, w)
+layout (std430, binding = 1) readonly buffer BoneDualQuaternions
+{
+    mat2x4 gBoneDualQuaternions[];
+};
+// if true dual quaternions are blended instead of matrices
+uniform bool gUseDualQuaternions;
+
+struct InstanceData
+{
+    // transformation * model of the instance
+    mat4 transformation;
+    // offset of the instance's palette in gBones or gBoneDualQuaternions
+    int boneOffset;
+};
+// per instance data of instanced draw calls
+layout (std430, binding = 2) readonly buffer Instances
+{
+    InstanceData gInstances[];
+};
+// if true the draw call is instanced, transformations and bones offset are
+// taken from gInstances[gInstanceBase + gl_InstanceID]
+uniform bool gInstanced;
+uniform int gInstanceBase;
+
+// blend bones dual quaternions and return the blended rigid transformation
+mat4 getDualQuaternionBoneTransform(int boneOffset)
+{
+    mat2x4 first = gBoneDualQuaternions[boneOffset + BoneIDs[0]];
+    mat2x4 blended = first * Weights[0];
+    for (int i = 1; i < 4; ++i)
+    {
+        mat2x4 dq = gBoneDualQuaternions[boneOffset + BoneIDs[i]];
+        // q and -q are the same rotation, take the one closer to the first
+        // bone so the blend goes the short way
+        float weight = dot(first[0], dq[0]) < 0.0 ? -Weights[i] : Weights[i];
+        blended += dq * weight;
+    }
+
+    float len = length(blended[0]);
+    if (len == 0.0)
+    {
+        return mat4(1.0);
+    }
+    vec4 r = blended[0] / len;
+    vec4 d = blended[1] / len;
+
+    vec3 translation = 2.0 * (r.w * d.xyz - d.w * r.xyz + cross(r.xyz, d.xyz));
+    return mat4(
+        1.0 - 2.0 * (r.y * r.y + r.z * r.z), 2.0 * (r.x * r.y + r.w * r.z),
+        2.0 * (r.x * r.z - r.w * r.y), 0.0,
+        2.0 * (r.x * r.y - r.w * r.z), 1.0 - 2.0 * (r.x * r.x + r.z * r.z),
+        2.0 * (r.y * r.z + r.w * r.x), 0.0,
+        2.0 * (r.x * r.z + r.w * r.y), 2.0 * (r.y * r.z - r.w * r.x),
+        1.0 - 2.0 * (r.x * r.x + r.y * r.y), 0.0,
+        translation, 1.0);
+}
 
 void main()
 {
+    mat4 modelTransformation = transformation * model;
+    int boneOffset = 0;
+    if (gInstanced)
+    {
+        InstanceData instance = gInstances[gInstanceBase + gl_InstanceID];
+        modelTransformation = instance.transformation;
+        boneOffset = instance.boneOffset;
+    }
+
     mat4 BoneTransform= mat4(0.0);
-    BoneTransform = gBones[BoneIDs[0]] * Weights[0];
-    BoneTransform += gBones[BoneIDs[1]] * Weights[1];
-    BoneTransform += gBones[BoneIDs[2]] * Weights[2];
-    BoneTransform += gBones[BoneIDs[3]] * Weights[3];
-    if (BoneTransform == mat4(0.0))
+    if (gUseDualQuaternions)
+    {
+        BoneTransform = getDualQuaternionBoneTransform(boneOffset);
+    }
+    else
     {
-            BoneTransform = mat4(1.0);
+        mat3x4 boneRows = gBones[boneOffset + BoneIDs[0]] * Weights[0];
+        boneRows += gBones[boneOffset + BoneIDs[1]] * Weights[1];
+        boneRows += gBones[boneOffset + BoneIDs[2]] * Weights[2];
+        boneRows += gBones[boneOffset + BoneIDs[3]] * Weights[3];
+        // rows become columns of a mat4x3, the missing last row is filled
+        // from identity
+        BoneTransform = mat4(transpose(boneRows));
+        if (boneRows == mat3x4(0.0))
+        {
+                BoneTransform = mat4(1.0);
+        }
     }
 
 	// calculates current position
-    crntPos = vec3(transformation*model*BoneTransform*vec4(aPos, 1.0f));
+    crntPos = vec3(modelTransformation*BoneTransform*vec4(aPos, 1.0f));
 
 	// Assigns the colors from the Vertex Data to "color"
 	color = aColor;
 	// Assigns the texture coordinates from the Vertex Data to "texCoord"
 	texCoord =  aTex;
 	// Assigns the normal from the Vertex Data to "Normal"
-	Normal = vec3(transformation*model*BoneTransform*vec4(aNormal,0.0f));
+	Normal = vec3(modelTransformation*BoneTransform*vec4(aNormal,0.0f));
 
 	// Outputs the positions/coordinates of all vertices
 	gl_Position = camMatrix * vec4(crntPos, 1.0);
@@ -12,9 +12,30 @@
 
 #include <iostream>
 
-AnimatedMesh::AnimatedMesh(const std::string &file_name)
-    : m_skinned_mesh(file_name), m_user_transformation(glm::mat4(1.0f)),
-      m_global_transformation(glm::mat4(1.0f)) {}
+namespace {
+const UniformHandle<glm::mat4> TRANSFORMATION_UNIFORM("transformation");
+
+// return number of updates between two pose evaluations
+unsigned int get_update_interval(AnimationLod animation_lod) {
+  switch (animation_lod) {
+  case AnimationLod::Full:
+    return 1;
+  case AnimationLod::Half:
+    return 2;
+  case AnimationLod::Quarter:
+    return 4;
+  default:
+    return 0;
+  }
+}
+} // namespace
+
+AnimatedMesh::AnimatedMesh(const std::string &file_name,
+                           const AnimationImportSettings &animation_settings)
+    : m_skinned_mesh(file_name, animation_settings),
+      m_user_transformation(glm::mat4(1.0f)),
+      m_global_transformation(glm::mat4(1.0f)),
+      m_animation_lod(AnimationLod::Full), m_skipped_updates(0) {}
 
 void AnimatedMesh::reset() {
   m_user_transformation = glm::mat4(1.0f);
@@ -22,26 +43,72 @@ void AnimatedMesh::reset() {
   clear_bounding_volumes();
 }
 
-std::pair<bool, glm::mat4>
-AnimatedMesh::update(const std::string &animation_name, float time_in_seconds,
-                     float speed_factor) {
+ClipId AnimatedMesh::get_clip_id(const std::string &animation_name) const {
+  return m_skinned_mesh.get_clip_id(animation_name);
+}
+
+PositionId
+AnimatedMesh::get_position_id(const std::string &position_name) const {
+  return m_skinned_mesh.get_position_id(position_name);
+}
+
+std::pair<bool, glm::mat4> AnimatedMesh::update(ClipId clip_id,
+                                                float time_in_seconds,
+                                                float speed_factor) {
+  // skipped updates only advance animation time and global transformation,
+  // the pose is evaluated when it's needed
+  unsigned int update_interval = get_update_interval(m_animation_lod);
+  bool defer_pose =
+      update_interval == 0 || ++m_skipped_updates < update_interval;
+  if (!defer_pose) {
+    m_skipped_updates = 0;
+  }
+
   auto [animation_finished, global_transformation] =
-      m_skinned_mesh.get_bones_for_animation(animation_name, time_in_seconds,
-                                             speed_factor);
+      m_skinned_mesh.get_bones_for_animation(clip_id, time_in_seconds,
+                                             speed_factor, defer_pose);
   clear_bounding_volumes();
   return {animation_finished, std::move(global_transformation)};
 }
 
-glm::mat4 AnimatedMesh::get_final_global_transformation_for_animation(
-    const std::string &animation_name) {
-  return m_skinned_mesh.get_final_global_transformation_for_animation(
-      animation_name);
+RootMotion AnimatedMesh::get_root_motion(ClipId clip_id,
+                                         float time_in_seconds,
+                                         float speed_factor) const {
+  return m_skinned_mesh.get_root_motion(clip_id, time_in_seconds,
+                                        speed_factor);
+}
+
+void AnimatedMesh::set_socket_nodes(
+    const std::vector<std::string> &node_names) {
+  m_skinned_mesh.set_socket_nodes(node_names);
+}
+
+unsigned int AnimatedMesh::add_pose_layer(const std::string &node_name,
+                                          PoseLayerMode mode) {
+  return m_skinned_mesh.add_pose_layer(node_name, mode);
 }
 
+void AnimatedMesh::set_skinning_mode(SkinningMode skinning_mode) {
+  m_skinned_mesh.set_skinning_mode(skinning_mode);
+}
+
+void AnimatedMesh::set_animation_lod(AnimationLod animation_lod) {
+  if (animation_lod != m_animation_lod) {
+    if (m_animation_lod == AnimationLod::Frozen) {
+      evaluate_pose();
+    }
+    // evaluate the pose on the next update
+    m_skipped_updates = get_update_interval(animation_lod);
+    m_animation_lod = animation_lod;
+  }
+}
+
+void AnimatedMesh::evaluate_pose() { m_skinned_mesh.evaluate_pose(); }
+
 void AnimatedMesh::render_to_texture(Shader &shader,
                                      const Camera &camera) const {
   shader.activate();
-  shader.set_uniform("transformation",
+  shader.set_uniform(TRANSFORMATION_UNIFORM,
                      m_user_transformation * m_global_transformation);
   m_skinned_mesh.render_to_texture(shader, camera);
 }
@@ -50,7 +117,7 @@ void AnimatedMesh::render_primitive(Shader &shader, const Camera &camera,
                                     unsigned int entry,
                                     unsigned int primitive) {
   shader.activate();
-  shader.set_uniform("transformation",
+  shader.set_uniform(TRANSFORMATION_UNIFORM,
                      m_user_transformation * m_global_transformation);
   m_skinned_mesh.render_primitive(shader, camera, entry, primitive);
 }
@@ -58,7 +125,7 @@ void AnimatedMesh::render_primitive(Shader &shader, const Camera &camera,
 void AnimatedMesh::render(Shader &shader, const Camera &camera,
                           const Light &light) const {
   shader.activate();
-  shader.set_uniform("transformation",
+  shader.set_uniform(TRANSFORMATION_UNIFORM,
                      m_user_transformation * m_global_transformation);
   m_skinned_mesh.render(shader, camera, light);
 }
@@ -68,14 +135,29 @@ void AnimatedMesh::render(Shader &shader, const Camera &camera,
                           const std::vector<unsigned int> &render_object_ids,
                           bool exclude) const {
   shader.activate();
-  shader.set_uniform("transformation",
+  shader.set_uniform(TRANSFORMATION_UNIFORM,
                      m_user_transformation * m_global_transformation);
   m_skinned_mesh.render(shader, camera, light, render_object_ids, exclude);
 }
 
+void AnimatedMesh::submit(RenderQueue &queue, RenderPass pass, Shader &shader,
+                          const Camera &camera) const {
+  m_skinned_mesh.submit(queue, pass, shader, camera,
+                        m_user_transformation * m_global_transformation);
+}
+
+void AnimatedMesh::submit(RenderQueue &queue, RenderPass pass, Shader &shader,
+                          const Camera &camera,
+                          const std::vector<unsigned int> &render_object_ids,
+                          bool exclude) const {
+  m_skinned_mesh.submit(queue, pass, shader, camera,
+                        m_user_transformation * m_global_transformation,
+                        render_object_ids, exclude);
+}
+
 void AnimatedMesh::render_boxes(Shader &bounding_box_shader,
                                 const Camera &camera) const {
-  render_boxes(*get_bvh(), bounding_box_shader, camera);
+  render_boxes(*get_exact_bvh(), bounding_box_shader, camera);
 }
 
 void AnimatedMesh::render_boxes(const BVHNode<BoundingBox> &node,
@@ -103,6 +185,11 @@ void AnimatedMesh::merge_user_and_global_transformations() {
 }
 
 std::unique_ptr<BVHNode<BoundingBox>> AnimatedMesh::get_bvh() const {
+  return std::make_unique<BVHNode<BoundingBox>>(m_skinned_mesh.get_bounds(
+      m_user_transformation * m_global_transformation));
+}
+
+std::unique_ptr<BVHNode<BoundingBox>> AnimatedMesh::get_exact_bvh() const {
   return m_skinned_mesh.get_bvh(m_user_transformation * m_global_transformation,
                                 true);
 }
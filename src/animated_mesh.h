@@ -11,19 +11,46 @@
 #include <glm/ext/vector_float3.hpp>
 #include <string>
 
+// how often the pose of an animated mesh is evaluated
+// global transformation is updated every frame regardless of the level
+enum class AnimationLod { Full, Half, Quarter, Frozen };
+
 class AnimatedMesh : public CollisionObject<BoundingBox> {
 public:
-  AnimatedMesh(const std::string &file_name);
+  AnimatedMesh(const std::string &file_name,
+               const AnimationImportSettings &animation_settings = {});
 
   void reset();
 
+  // return handle of the animation with the given name
+  ClipId get_clip_id(const std::string &animation_name) const;
+  // return handle of the position with the given name
+  PositionId get_position_id(const std::string &position_name) const;
+
   // return true if animation is finished and return global transformation
-  std::pair<bool, glm::mat4> update(const std::string &animation_name,
-                                    float time_in_seconds,
+  std::pair<bool, glm::mat4> update(ClipId clip_id, float time_in_seconds,
                                     float speed_factor = 1.0f);
 
-  glm::mat4 get_final_global_transformation_for_animation(
-      const std::string &animation_name);
+  // return root motion of the animation at the given time, the pose is not
+  // evaluated
+  RootMotion get_root_motion(ClipId clip_id, float time_in_seconds,
+                             float speed_factor = 1.0f) const;
+
+  // nodes whose transformations are queried while the pose is not evaluated
+  void set_socket_nodes(const std::vector<std::string> &node_names);
+
+  // add procedural rotation layer on top of the animations for the node
+  unsigned int add_pose_layer(const std::string &node_name,
+                              PoseLayerMode mode);
+
+  void set_skinning_mode(SkinningMode skinning_mode);
+
+  // mesh that stops being frozen evaluates its pose right away, so it's not
+  // rendered in the pose it was frozen in
+  void set_animation_lod(AnimationLod animation_lod);
+  // evaluate pose deferred by the animation lod
+  void evaluate_pose();
+  AnimationLod animation_lod() const { return m_animation_lod; }
 
   virtual void render(Shader &shader, const Camera &camera, const Light &light,
                       const std::vector<unsigned int> &render_object_ids,
@@ -32,6 +59,14 @@ public:
   virtual void render(Shader &shader, const Camera &camera,
                       const Light &light) const;
 
+  // add draw items to the queue instead of rendering right away
+  void submit(RenderQueue &queue, RenderPass pass, Shader &shader,
+              const Camera &camera) const;
+  void submit(RenderQueue &queue, RenderPass pass, Shader &shader,
+              const Camera &camera,
+              const std::vector<unsigned int> &render_object_ids,
+              bool exclude) const;
+
   virtual void render_boxes(Shader &bounding_box_shader,
                             const Camera &camera) const;
 
@@ -49,7 +84,10 @@ public:
     return m_user_transformation * m_global_transformation;
   }
 
+  // aabb looked up in the precomputed animation bounds
   std::unique_ptr<BVHNode<BoundingBox>> get_bvh() const override;
+  // aabb merged from the current bones boxes
+  std::unique_ptr<BVHNode<BoundingBox>> get_exact_bvh() const override;
 
 private:
   void render_boxes(const BVHNode<BoundingBox> &node,
@@ -60,6 +98,10 @@ protected:
 
   glm::mat4 m_user_transformation;
   glm::mat4 m_global_transformation;
+
+  AnimationLod m_animation_lod;
+  // number of updates since the pose was evaluated last time
+  unsigned int m_skipped_updates;
 };
 
 #endif /* _ANIMATED_MESH_H_ */
@@ -1,6 +1,17 @@
 #include "animation.h"
 #include "channel.h"
-#include <iostream>
+#include "skinned_mesh.h"
+#include "utility.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/ext/scalar_constants.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+
+namespace {
+// root motion samples per second
+const float ROOT_MOTION_SAMPLE_RATE = 30.0f;
+} // namespace
 
 Animation::Animation(std::string name, std::vector<Channel> channels,
                      std::unordered_map<std::string, int> channels_map,
@@ -9,7 +20,8 @@ Animation::Animation(std::string name, std::vector<Channel> channels,
       m_channels_map(std::move(channels_map)), m_duration(duration),
       m_ticks_per_second(ticks_per_second) {}
 
-Animation::Animation(const aiAnimation *animation)
+Animation::Animation(const aiAnimation *animation,
+                     const AnimationImportSettings &settings)
     : m_name(animation->mName.C_Str()), m_duration(animation->mDuration),
       m_ticks_per_second(animation->mTicksPerSecond != 0
                              ? animation->mTicksPerSecond
@@ -20,6 +32,196 @@ Animation::Animation(const aiAnimation *animation)
     m_channels_map.emplace(channel->mNodeName.data, m_channels.size());
     m_channels.emplace_back(channel);
   }
+  m_import_stats.keys_count = get_keys_count();
+  m_import_stats.memory_size = get_memory_size();
+
+  if (settings.sample_rate > 0.0f) {
+    // frames are sampled from the original keyframes, so the reduction error
+    // isn't baked into them, only the frames are compressed because
+    // keyframes are released after resampling
+    if (settings.reduce) {
+      reduce_constant_channels(settings.reduction_tolerance);
+    }
+    resample(settings.sample_rate);
+    if (settings.compress) {
+      m_import_stats.frames_compressed = compress_frames(settings.tolerance);
+    }
+  } else {
+    if (settings.reduce) {
+      reduce(settings.reduction_tolerance);
+    }
+
+    if (settings.compress) {
+      compress(settings.tolerance);
+    }
+  }
+
+  m_import_stats.imported_keys_count = get_keys_count();
+  m_import_stats.imported_memory_size = get_memory_size();
+}
+
+void Animation::reduce(const CompressionTolerance &tolerance) {
+  for (auto &channel : m_channels) {
+    channel.reduce(tolerance);
+    if (channel.is_constant()) {
+      ++m_import_stats.constant_channels;
+    }
+  }
+}
+
+void Animation::reduce_constant_channels(
+    const CompressionTolerance &tolerance) {
+  for (auto &channel : m_channels) {
+    Channel reduced_channel = channel;
+    reduced_channel.reduce(tolerance);
+    if (reduced_channel.is_constant()) {
+      channel = std::move(reduced_channel);
+      ++m_import_stats.constant_channels;
+    }
+  }
+}
+
+void Animation::resample(float sample_rate) {
+  // frames are evenly spaced and the last one is exactly at the end of the
+  // animation
+  m_frame_count =
+      m_duration > 0.0f
+          ? static_cast<unsigned int>(
+                std::ceil(m_duration * sample_rate / m_ticks_per_second)) +
+                1
+          : 1;
+  m_frame_duration = m_frame_count > 1 ? m_duration / (m_frame_count - 1) : 0;
+
+  // constant channels are sampled without interpolation, they don't need
+  // frames
+  m_frame_columns.assign(m_channels.size(), -1);
+  m_frame_columns_count = 0;
+  for (unsigned int c = 0; c < m_channels.size(); ++c) {
+    if (!m_channels[c].is_constant()) {
+      m_frame_columns[c] = m_frame_columns_count++;
+    }
+  }
+
+  unsigned int keys_count = m_frame_count * m_frame_columns_count;
+  m_frame_translations.resize(keys_count);
+  m_frame_rotations.resize(keys_count);
+  m_frame_scalings.resize(keys_count);
+
+  ChannelSample sample;
+  for (unsigned int c = 0; c < m_channels.size(); ++c) {
+    int column = m_frame_columns[c];
+    if (column < 0) {
+      continue;
+    }
+
+    // frames are sampled in order, so cursor finds keyframes in constant time
+    ChannelCursor cursor;
+    for (unsigned int f = 0; f < m_frame_count; ++f) {
+      float frame_time = std::min(f * m_frame_duration, m_duration);
+      m_channels[c].sample(frame_time, sample, cursor);
+      unsigned int key_index = f * m_frame_columns_count + column;
+      m_frame_translations[key_index] = sample.translation;
+      m_frame_rotations[key_index] = sample.rotation;
+      m_frame_scalings[key_index] = sample.scaling;
+    }
+
+    // channel is sampled only from the frames from now on
+    m_channels[c].release_keys();
+  }
+}
+
+void Animation::compress(const CompressionTolerance &tolerance) {
+  for (auto &channel : m_channels) {
+    if (!channel.compress(tolerance)) {
+      ++m_import_stats.uncompressed_channels;
+    }
+  }
+}
+
+bool Animation::compress_frames(const CompressionTolerance &tolerance) {
+  unsigned int columns_count = m_frame_columns_count;
+  std::vector<QuantizationRange> translation_ranges(columns_count);
+  std::vector<QuantizationRange> scaling_ranges(columns_count);
+
+  std::vector<glm::vec3> translations(m_frame_count);
+  std::vector<glm::vec3> scalings(m_frame_count);
+  for (unsigned int c = 0; c < columns_count; ++c) {
+    for (unsigned int f = 0; f < m_frame_count; ++f) {
+      translations[f] = m_frame_translations[f * columns_count + c];
+      scalings[f] = m_frame_scalings[f * columns_count + c];
+    }
+    translation_ranges[c] = quantization::get_range(translations);
+    scaling_ranges[c] = quantization::get_range(scalings);
+  }
+
+  unsigned int keys_count = m_frame_translations.size();
+  std::vector<QuantizedVec3> quantized_translations(keys_count);
+  std::vector<QuantizedQuat> quantized_rotations(keys_count);
+  std::vector<QuantizedVec3> quantized_scalings(keys_count);
+
+  for (unsigned int i = 0; i < keys_count; ++i) {
+    unsigned int c = i % columns_count;
+    quantized_translations[i] =
+        quantization::quantize(m_frame_translations[i], translation_ranges[c]);
+    quantized_rotations[i] = quantization::quantize(m_frame_rotations[i]);
+    quantized_scalings[i] =
+        quantization::quantize(m_frame_scalings[i], scaling_ranges[c]);
+
+    if (quantization::get_vector_error(
+            m_frame_translations[i],
+            quantization::dequantize(quantized_translations[i],
+                                     translation_ranges[c])) >
+            tolerance.translation ||
+        quantization::get_rotation_error(
+            m_frame_rotations[i],
+            quantization::dequantize(quantized_rotations[i])) >
+            tolerance.rotation ||
+        quantization::get_vector_error(
+            m_frame_scalings[i],
+            quantization::dequantize(quantized_scalings[i],
+                                     scaling_ranges[c])) > tolerance.scaling) {
+      return false;
+    }
+  }
+
+  m_quantized_frame_translations = std::move(quantized_translations);
+  m_quantized_frame_rotations = std::move(quantized_rotations);
+  m_quantized_frame_scalings = std::move(quantized_scalings);
+  m_frame_translation_ranges = std::move(translation_ranges);
+  m_frame_scaling_ranges = std::move(scaling_ranges);
+
+  // release full precision frames
+  std::vector<glm::vec3>().swap(m_frame_translations);
+  std::vector<glm::quat>().swap(m_frame_rotations);
+  std::vector<glm::vec3>().swap(m_frame_scalings);
+  return true;
+}
+
+unsigned int Animation::get_keys_count() const {
+  unsigned int keys_count = 0;
+  for (const auto &channel : m_channels) {
+    keys_count += channel.get_keys_count();
+  }
+
+  // every frame of a column has a translation, rotation and scaling
+  return keys_count + 3 * m_frame_count * m_frame_columns_count;
+}
+
+unsigned int Animation::get_memory_size() const {
+  unsigned int memory_size = 0;
+  for (const auto &channel : m_channels) {
+    memory_size += channel.get_memory_size();
+  }
+
+  return memory_size + m_frame_columns.size() * sizeof(int) +
+         m_frame_translations.size() * sizeof(glm::vec3) +
+         m_frame_rotations.size() * sizeof(glm::quat) +
+         m_frame_scalings.size() * sizeof(glm::vec3) +
+         m_quantized_frame_translations.size() * sizeof(QuantizedVec3) +
+         m_quantized_frame_rotations.size() * sizeof(QuantizedQuat) +
+         m_quantized_frame_scalings.size() * sizeof(QuantizedVec3) +
+         m_frame_translation_ranges.size() * sizeof(QuantizationRange) +
+         m_frame_scaling_ranges.size() * sizeof(QuantizationRange);
 }
 
 float Animation::get_animation_time(float time_in_seconds,
@@ -38,7 +240,7 @@ float Animation::get_animation_time(float time_in_seconds,
   return std::min(time_in_ticks, m_duration);
 }
 
-Channel *Animation::get_channel(const std::string &name) {
+const Channel *Animation::get_channel(const std::string &name) const {
   auto it = m_channels_map.find(name);
   if (it != m_channels_map.end()) {
     return &m_channels[it->second];
@@ -46,3 +248,169 @@ Channel *Animation::get_channel(const std::string &name) {
 
   return nullptr;
 }
+
+const Channel *Animation::get_channel(unsigned int node_index) const {
+  assert(node_index < m_node_channels.size() && "animation is bound");
+  int channel_index = m_node_channels[node_index];
+  return channel_index >= 0 ? &m_channels[channel_index] : nullptr;
+}
+
+void Animation::bind(const std::vector<const TransformationNode *> &nodes) {
+  m_node_channels.assign(nodes.size(), -1);
+  for (unsigned int i = 0; i < nodes.size(); ++i) {
+    auto it = m_channels_map.find(nodes[i]->name);
+    if (it != m_channels_map.end()) {
+      m_node_channels[i] = it->second;
+    }
+  }
+
+  init_root_motion();
+}
+
+namespace {
+// return angle of the rotated x-axis around y-axis in XZ plane
+float get_yaw(const glm::quat &rotation) {
+  glm::vec3 x_axis = rotation * glm::vec3(1, 0, 0);
+  return std::atan2(-x_axis.z, x_axis.x);
+}
+
+// return yaw equivalent to the given one that is the closest to the reference
+float unwrap_yaw(float yaw, float reference_yaw) {
+  return reference_yaw +
+         std::remainder(yaw - reference_yaw, 2 * glm::pi<float>());
+}
+} // namespace
+
+void Animation::init_root_motion() {
+  m_root_motion.clear();
+  if (m_node_channels.empty() || m_node_channels[0] < 0) {
+    return;
+  }
+
+  unsigned int samples_count =
+      m_duration > 0.0f
+          ? static_cast<unsigned int>(std::ceil(
+                m_duration * ROOT_MOTION_SAMPLE_RATE / m_ticks_per_second)) +
+                1
+          : 1;
+  m_root_motion_step =
+      samples_count > 1 ? m_duration / (samples_count - 1) : 0.0f;
+  m_root_motion.reserve(samples_count);
+
+  ChannelSample sample;
+  ChannelCursor cursor;
+  for (unsigned int i = 0; i < samples_count; ++i) {
+    this->sample(0, std::min(i * m_root_motion_step, m_duration), sample,
+                 cursor);
+
+    float yaw = get_yaw(sample.rotation);
+    if (!m_root_motion.empty()) {
+      // keep yaw continuous over the whole animation
+      yaw = unwrap_yaw(yaw, m_root_motion.back().yaw);
+    }
+    m_root_motion.push_back({sample.translation, yaw});
+  }
+}
+
+RootMotion Animation::get_root_motion(float animation_time) const {
+  if (m_root_motion.size() < 2) {
+    return m_root_motion.empty() ? RootMotion{} : m_root_motion[0];
+  }
+
+  // samples are evenly spaced, so the neighbouring samples are indexed
+  // directly
+  float position =
+      std::clamp(animation_time / m_root_motion_step, 0.0f,
+                 static_cast<float>(m_root_motion.size() - 1));
+  unsigned int index = std::min(static_cast<unsigned int>(position),
+                                static_cast<unsigned int>(
+                                    m_root_motion.size() - 2));
+  float factor = position - index;
+
+  const auto &start = m_root_motion[index];
+  const auto &end = m_root_motion[index + 1];
+  return {glm::mix(start.translation, end.translation, factor),
+          glm::mix(start.yaw, end.yaw, factor)};
+}
+
+glm::mat4 RootMotion::get_transformation() const {
+  return glm::translate(translation) * glm::rotate(yaw, glm::vec3(0, 1, 0));
+}
+
+glm::mat4 RootMotion::get_inverse_transformation() const {
+  return glm::rotate(-yaw, glm::vec3(0, 1, 0)) * glm::translate(-translation);
+}
+
+bool Animation::sample(unsigned int node_index, float animation_time,
+                       ChannelSample &sample, ChannelCursor &cursor) const {
+  assert(node_index < m_node_channels.size() && "animation is bound");
+  int channel_index = m_node_channels[node_index];
+  if (channel_index < 0) {
+    return false;
+  }
+
+  // constant channel is not interpolated at all
+  if (is_resampled() && m_frame_columns[channel_index] >= 0) {
+    sample_frame(m_frame_columns[channel_index], animation_time, sample);
+  } else {
+    m_channels[channel_index].sample(animation_time, sample, cursor);
+  }
+
+  return true;
+}
+
+void Animation::sample_frame(unsigned int column, float animation_time,
+                             ChannelSample &sample) const {
+  unsigned int frame = 0;
+  float factor = 0.0f;
+  if (m_frame_count > 1) {
+    // frame is found directly from time, no search is needed
+    float frame_position =
+        std::clamp(animation_time / m_frame_duration, 0.0f,
+                   static_cast<float>(m_frame_count - 1));
+    frame = std::min(static_cast<unsigned int>(frame_position),
+                     m_frame_count - 2);
+    factor = frame_position - frame;
+  }
+
+  unsigned int key_index = frame * m_frame_columns_count + column;
+  unsigned int next_key_index =
+      m_frame_count > 1 ? key_index + m_frame_columns_count : key_index;
+
+  sample.translation =
+      glm::mix(get_frame_translation(key_index, column),
+               get_frame_translation(next_key_index, column), factor);
+  sample.rotation = glm::normalize(glm::slerp(
+      get_frame_rotation(key_index), get_frame_rotation(next_key_index),
+      factor));
+  sample.scaling =
+      glm::mix(get_frame_scaling(key_index, column),
+               get_frame_scaling(next_key_index, column), factor);
+  sample.transformation = utility::compose_transformation(
+      sample.translation, sample.rotation, sample.scaling);
+}
+
+glm::vec3 Animation::get_frame_translation(unsigned int key_index,
+                                           unsigned int column) const {
+  if (m_frame_translations.empty()) {
+    return quantization::dequantize(m_quantized_frame_translations[key_index],
+                                    m_frame_translation_ranges[column]);
+  }
+  return m_frame_translations[key_index];
+}
+
+glm::quat Animation::get_frame_rotation(unsigned int key_index) const {
+  if (m_frame_rotations.empty()) {
+    return quantization::dequantize(m_quantized_frame_rotations[key_index]);
+  }
+  return m_frame_rotations[key_index];
+}
+
+glm::vec3 Animation::get_frame_scaling(unsigned int key_index,
+                                       unsigned int column) const {
+  if (m_frame_scalings.empty()) {
+    return quantization::dequantize(m_quantized_frame_scalings[key_index],
+                                    m_frame_scaling_ranges[column]);
+  }
+  return m_frame_scalings[key_index];
+}
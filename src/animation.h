@@ -6,13 +6,72 @@
 
 #include <assimp/scene.h>
 
+#include <cstddef>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+struct TransformationNode;
+
+// how imported animations are stored
+struct AnimationImportSettings {
+  // if sample rate (frames per second) is not 0, channels are resampled to
+  // evenly spaced frames, so sampling doesn't need to search for keyframes
+  float sample_rate = 0.0f;
+  // if true, keyframes (or frames of resampled animation) are quantized as
+  // long as the error is within the tolerance
+  bool compress = false;
+  CompressionTolerance tolerance;
+  // if true, keyframes that can be interpolated from their neighbours within
+  // the reduction tolerance are removed before compression
+  // resampled animations are resampled from the original keyframes, the
+  // reduction only finds their constant channels
+  bool reduce = false;
+  CompressionTolerance reduction_tolerance;
+  // if not 0, animations are baked at this sample rate (frames per second)
+  // into a pose cache shared by all the copies of the mesh
+  float bake_rate = 0.0f;
+  // maximum size of the baked animations in bytes
+  std::size_t bake_memory_limit = 16 * 1024 * 1024;
+};
+
+// what the import settings did to the keyframes of one animation
+struct AnimationImportStats {
+  // keyframes and their size in bytes before reduction, resampling and
+  // compression
+  unsigned int keys_count = 0;
+  unsigned int memory_size = 0;
+  // size in bytes after the import, memory saved by the import is
+  // memory_size - imported_memory_size
+  unsigned int imported_memory_size = 0;
+  // keyframes left after the import, resampled frames count as one
+  // translation, rotation and scaling keyframe per frame of each
+  // non-constant channel
+  unsigned int imported_keys_count = 0;
+  unsigned int constant_channels = 0;
+  // channels or frames kept at full precision because the compression error
+  // was greater than the tolerance
+  unsigned int uncompressed_channels = 0;
+  bool frames_compressed = false;
+};
+
+// root node's translation and rotation around y-axis at some animation time,
+// difference between two times is the motion of the whole object
+struct RootMotion {
+  glm::vec3 translation = glm::vec3(0.0f);
+  // angle in radians, continuous over the whole animation
+  float yaw = 0.0f;
+
+  // return transformation of the object moved by the root motion
+  glm::mat4 get_transformation() const;
+  // return transformation that undoes the root motion
+  glm::mat4 get_inverse_transformation() const;
+};
+
 class Animation {
 public:
-  Animation(const aiAnimation *animation);
+  Animation(const aiAnimation *animation,
+            const AnimationImportSettings &settings = {});
   Animation(std::string name, std::vector<Channel> channels,
             std::unordered_map<std::string, int> channels_map, float duration,
             int ticks_per_second);
@@ -20,7 +79,56 @@ public:
   float get_animation_time(float time_in_seconds,
                            float speed_factor = 1.0f) const;
 
-  Channel *get_channel(const std::string &name);
+  const Channel *get_channel(const std::string &name) const;
+  // return channel of the node with the given index (index in nodes vector
+  // used for binding)
+  const Channel *get_channel(unsigned int node_index) const;
+
+  // bind channels to nodes given in depth-first order, so channels can be
+  // found by node index instead of node name
+  // root node's motion is extracted after binding
+  void bind(const std::vector<const TransformationNode *> &nodes);
+
+  // return root motion at the given animation time (zero if root node is not
+  // animated), interpolated between the samples baked at load
+  RootMotion get_root_motion(float animation_time) const;
+
+  // sample local transformation of the node with the given index
+  // return false if node is not animated
+  bool sample(unsigned int node_index, float animation_time,
+              ChannelSample &sample, ChannelCursor &cursor) const;
+
+  bool is_resampled() const { return m_frame_count != 0; }
+
+  // return number of keyframes and resampled frames' keyframes
+  unsigned int get_keys_count() const;
+  // return size of the keyframes in bytes
+  unsigned int get_memory_size() const;
+  const AnimationImportStats &import_stats() const { return m_import_stats; }
+
+private:
+  void reduce(const CompressionTolerance &tolerance);
+  // replace channels whose reduced keyframes are constant with the reduced
+  // channels, other channels keep all their keyframes
+  void reduce_constant_channels(const CompressionTolerance &tolerance);
+  // sample channels that are not constant into frames and release their
+  // keyframes
+  void resample(float sample_rate);
+  void compress(const CompressionTolerance &tolerance);
+  // quantize resampled frames, return false if the error is greater than the
+  // tolerance
+  bool compress_frames(const CompressionTolerance &tolerance);
+
+  void sample_frame(unsigned int column, float animation_time,
+                    ChannelSample &sample) const;
+  glm::vec3 get_frame_translation(unsigned int key_index,
+                                  unsigned int column) const;
+  glm::quat get_frame_rotation(unsigned int key_index) const;
+  glm::vec3 get_frame_scaling(unsigned int key_index,
+                              unsigned int column) const;
+
+  // sample root's translation and yaw at evenly spaced times
+  void init_root_motion();
 
   // TODO fix set private
 public:
@@ -31,6 +139,41 @@ public:
   std::vector<Channel> m_channels;
   // channel name -> channel index in m_channels
   std::unordered_map<std::string, int> m_channels_map;
+  // node index -> channel index in m_channels (-1 if node has no channel)
+  std::vector<int> m_node_channels;
+
+private:
+  // resampled channels (empty if animation is not resampled)
+  // only channels that are not constant are resampled, each of them has a
+  // column in the frames and keys of all the columns in one frame are
+  // adjacent
+  // frame f, column c -> index f * m_frame_columns_count + c
+  unsigned int m_frame_count = 0;
+  unsigned int m_frame_columns_count = 0;
+  // channel index -> column in the frames (-1 if channel is not resampled)
+  std::vector<int> m_frame_columns;
+  // time between two frames in ticks
+  float m_frame_duration = 0.0f;
+  std::vector<glm::vec3> m_frame_translations;
+  std::vector<glm::quat> m_frame_rotations;
+  std::vector<glm::vec3> m_frame_scalings;
+
+  // quantized resampled channels, used instead of the frames above if the
+  // animation is compressed
+  std::vector<QuantizedVec3> m_quantized_frame_translations;
+  std::vector<QuantizedQuat> m_quantized_frame_rotations;
+  std::vector<QuantizedVec3> m_quantized_frame_scalings;
+  // column -> range of column's quantized translations and scalings
+  std::vector<QuantizationRange> m_frame_translation_ranges;
+  std::vector<QuantizationRange> m_frame_scaling_ranges;
+
+  AnimationImportStats m_import_stats;
+
+  // root motion sampled at evenly spaced times (empty if root node is not
+  // animated), yaw is continuous over the whole animation
+  std::vector<RootMotion> m_root_motion;
+  // time between two root motion samples in ticks
+  float m_root_motion_step = 0.0f;
 };
 
 #endif /* _ANIMATION_H_ */
@@ -5,7 +5,8 @@
 AnimationController::AnimationController(AnimatedMesh &mesh, std::string name,
                                          bool reversed, float speed_factor,
                                          bool update_global)
-    : m_mesh(mesh), m_name(std::move(name)), m_reversed(reversed),
+    : m_mesh(mesh), m_name(std::move(name)),
+      m_clip(m_mesh.get_clip_id(m_name)), m_reversed(reversed),
       m_speed_factor(speed_factor), m_update_global(update_global),
       m_current_animation_time(m_reversed ? -1 : 0),
       m_sound_track(std::nullopt) {}
@@ -14,27 +15,28 @@ AnimationController::AnimationController(AnimatedMesh &mesh, std::string name,
                                          Sound::Track sound_track,
                                          bool reversed, float speed_factor,
                                          bool update_global)
-    : m_mesh(mesh), m_name(std::move(name)), m_reversed(reversed),
+    : m_mesh(mesh), m_name(std::move(name)),
+      m_clip(m_mesh.get_clip_id(m_name)), m_reversed(reversed),
       m_speed_factor(speed_factor), m_update_global(update_global),
       m_current_animation_time(m_reversed ? -1 : 0),
       m_sound_track(sound_track) {}
 
 std::pair<bool, glm::mat4> AnimationController::update(float delta_time) {
   if (m_update_global && m_reversed && m_first_tick) {
-    // set inverse of global transformation
-    m_mesh.set_user_transformation(
-        m_mesh.user_transformation() *
-        glm::inverse(
-            m_mesh.get_final_global_transformation_for_animation(m_name)));
+    // reversed animation starts at its end, undo root motion of the whole
+    // animation
+    m_mesh.set_user_transformation(m_mesh.user_transformation() *
+                                   root_motion().get_inverse_transformation());
   }
 
   update_animation_time(delta_time);
 
   auto [animation_finished, global_transformation] =
-      m_mesh.update(m_name, m_current_animation_time, m_speed_factor);
+      m_mesh.update(m_clip, m_current_animation_time, m_speed_factor);
 
   if (m_update_global) {
-    m_mesh.set_global_transformation(global_transformation);
+    // root motion is baked at load, root's matrix is not used
+    m_mesh.set_global_transformation(root_motion().get_transformation());
   }
 
   if (m_first_tick && m_sound_track) {
@@ -50,6 +52,11 @@ std::pair<bool, glm::mat4> AnimationController::update(float delta_time) {
   return {animation_finished, std::move(global_transformation)};
 }
 
+RootMotion AnimationController::root_motion() const {
+  return m_mesh.get_root_motion(m_clip, m_current_animation_time,
+                                m_speed_factor);
+}
+
 void AnimationController::reset_animation() {
   m_current_animation_time = m_reversed ? -1 : 0;
   m_first_tick = true;
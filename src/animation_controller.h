@@ -22,6 +22,9 @@ struct AnimationController {
                       float speed_factor = 1.0f, bool update_global = false);
   std::pair<bool, glm::mat4> update(float delta_time);
 
+  // return root motion at the current animation time
+  RootMotion root_motion() const;
+
   void on_animation_stop();
 
   void reset();
@@ -35,6 +38,8 @@ public:
 
   // animation name
   std::string m_name;
+  // animation handle resolved from the name once
+  ClipId m_clip;
   // is animation reversed
   bool m_reversed;
   // default animation speed factor is 1
@@ -0,0 +1,33 @@
+#include "bone_buffer.h"
+
+BoneBuffer::BoneBuffer() : m_id(0), m_size(0), m_version(0) {}
+
+BoneBuffer::BoneBuffer(const BoneBuffer &other)
+    : m_id(0), m_size(0), m_version(0) {}
+
+BoneBuffer::~BoneBuffer() {
+  if (m_id != 0) {
+    glDeleteBuffers(1, &m_id);
+  }
+}
+
+void BoneBuffer::upload(const void *data, GLsizeiptr size,
+                        unsigned int version) {
+  if (m_id == 0) {
+    glCreateBuffers(1, &m_id);
+  }
+
+  if (size > m_size) {
+    // palette size doesn't change after loading, so this happens only on the
+    // first upload
+    glNamedBufferData(m_id, size, data, GL_DYNAMIC_DRAW);
+    m_size = size;
+  } else {
+    glNamedBufferSubData(m_id, 0, size, data);
+  }
+  m_version = version;
+}
+
+void BoneBuffer::bind(GLuint binding) const {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_id);
+}
@@ -0,0 +1,38 @@
+#ifndef _BONE_BUFFER_H_
+#define _BONE_BUFFER_H_
+
+#include <GL/glew.h>
+
+// shader storage buffer with the bones palette of one skinned mesh copy,
+// palette is uploaded as one block when the pose changes and every draw call
+// only binds the buffer
+// render queue uses it for the palettes and per instance data of all the
+// instances of its instanced draw calls
+// gl buffer is created on the first upload, so a copy gets its own buffer
+// instead of sharing the original's
+class BoneBuffer {
+public:
+  BoneBuffer();
+  BoneBuffer(const BoneBuffer &other);
+  ~BoneBuffer();
+
+  BoneBuffer &operator=(const BoneBuffer &) = delete;
+
+  // return true if the palette of the given pose version is uploaded
+  bool is_uploaded(unsigned int version) const {
+    return m_id != 0 && m_version == version;
+  }
+
+  void upload(const void *data, GLsizeiptr size, unsigned int version);
+
+  void bind(GLuint binding) const;
+
+private:
+  GLuint m_id;
+  // allocated size in bytes
+  GLsizeiptr m_size;
+  // pose version of the uploaded palette
+  unsigned int m_version;
+};
+
+#endif /* _BONE_BUFFER_H_ */
@@ -14,6 +14,11 @@
 #define FLOAT_MAX (std::numeric_limits<float>::infinity())
 #define EPS 0.0001
 
+namespace {
+const UniformHandle<glm::vec3> COLOR_UNIFORM("Color");
+const UniformHandle<glm::mat4> CAM_MATRIX_UNIFORM("camMatrix");
+} // namespace
+
 BoundingBox::BoundingBox(const AABB &aabb)
     : BoundingBox({glm::vec3(aabb.max_x - aabb.min_x, 0, 0),
                    glm::vec3(0, aabb.max_y - aabb.min_y, 0),
@@ -72,10 +77,9 @@ void BoundingBox::render(Shader &shader, const Camera &camera,
 
   shader.activate();
 
-  glUniform3f(glGetUniformLocation(shader.id(), "Color"), color[0], color[1],
-              color[2]);
+  shader.set_uniform(COLOR_UNIFORM, color);
 
-  shader.set_uniform("camMatrix", camera.matrix());
+  shader.set_uniform(CAM_MATRIX_UNIFORM, camera.matrix());
   glDrawElements(GL_LINES, indices.size(), GL_UNSIGNED_INT, 0);
 
   // unbind
@@ -1,6 +1,7 @@
 #include "channel.h"
 #include "utility.h"
 #include <algorithm>
+#include <cassert>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/transform.hpp>
 #include <iostream>
@@ -10,7 +11,9 @@ Channel::Channel(std::string name, std::vector<KeyPosition> positions,
                  std::vector<KeyRotation> rotations,
                  std::vector<KeyScale> scales)
     : m_name(std::move(name)), m_positions(std::move(positions)),
-      m_rotations(std::move(rotations)), m_scales(std::move(scales)) {}
+      m_rotations(std::move(rotations)), m_scales(std::move(scales)) {
+  update_constant();
+}
 
 Channel::Channel(const aiNodeAnim *channel) : m_name(channel->mNodeName.data) {
 
@@ -43,37 +46,335 @@ Channel::Channel(const aiNodeAnim *channel) : m_name(channel->mNodeName.data) {
     data.timeStamp = timeStamp;
     m_scales.push_back(data);
   }
+
+  update_constant();
+}
+
+namespace {
+template <typename Key> float get_time_stamp(const Key &key) {
+  return key.timeStamp;
+}
+
+float get_time_stamp(float time_stamp) { return time_stamp; }
+
+// return true if keyframe with the given index is the one that precedes the
+// animation time, keys are sorted by time stamp
+template <typename Key>
+bool is_key_index(const std::vector<Key> &keys, unsigned int index,
+                  float animation_time) {
+  return index < keys.size() &&
+         (index == 0 || get_time_stamp(keys[index]) <= animation_time) &&
+         (index == keys.size() - 1 ||
+          animation_time < get_time_stamp(keys[index + 1]));
+}
+
+// return index of the last keyframe whose time stamp is not greater than the
+// animation time (0 if there is no such keyframe)
+// hint is the index returned by the previous call, when animation is played
+// forward or backward the result is the hint or its neighbour, otherwise
+// binary search is used
+template <typename Key>
+int find_key_index(const std::vector<Key> &keys, float animation_time,
+                   unsigned int &hint) {
+  if (is_key_index(keys, hint, animation_time)) {
+    return hint;
+  }
+
+  if (is_key_index(keys, hint + 1, animation_time)) {
+    return ++hint;
+  }
+
+  if (hint > 0 && is_key_index(keys, hint - 1, animation_time)) {
+    return --hint;
+  }
+
+  // time jumped, find the first keyframe after the animation time ignoring the
+  // first keyframe
+  auto next_key_it = std::upper_bound(
+      keys.begin() + 1, keys.end(), animation_time,
+      [](float time, const Key &key) { return time < get_time_stamp(key); });
+  hint = (next_key_it - keys.begin()) - 1;
+  assert(is_key_index(keys, hint, animation_time) && "key index valid");
+  return hint;
+}
+
+// remove keyframes that can be interpolated from the kept neighbours with
+// error not greater than the tolerance
+// get_value returns keyframe's value, interpolate interpolates two values
+// and get_error returns error between two values
+template <typename Key, typename GetValue, typename Interpolate,
+          typename GetError>
+void reduce_keys(std::vector<Key> &keys, float tolerance, GetValue get_value,
+                 Interpolate interpolate, GetError get_error) {
+  if (keys.size() < 2) {
+    return;
+  }
+
+  // keyframes are all equal, one is enough
+  bool constant = std::all_of(keys.begin(), keys.end(), [&](const Key &key) {
+    return get_error(get_value(keys[0]), get_value(key)) <= tolerance;
+  });
+  if (constant) {
+    keys.resize(1);
+    return;
+  }
+
+  std::vector<Key> reduced_keys{keys[0]};
+  unsigned int last_kept_index = 0;
+  for (unsigned int i = 1; i + 1 < keys.size(); ++i) {
+    // keyframe can be removed if all the keyframes after the last kept one,
+    // including this one, are interpolated well enough from the last kept
+    // keyframe and the next one
+    const Key &last_key = reduced_keys.back();
+    const Key &next_key = keys[i + 1];
+    bool removable = true;
+    for (unsigned int j = last_kept_index + 1; j <= i && removable; ++j) {
+      float factor = (keys[j].timeStamp - last_key.timeStamp) /
+                     (next_key.timeStamp - last_key.timeStamp);
+      removable = get_error(get_value(keys[j]),
+                            interpolate(get_value(last_key),
+                                        get_value(next_key), factor)) <=
+                  tolerance;
+    }
+
+    if (!removable) {
+      reduced_keys.push_back(keys[i]);
+      last_kept_index = i;
+    }
+  }
+  reduced_keys.push_back(keys.back());
+
+  keys = std::move(reduced_keys);
+}
+} // namespace
+
+void Channel::sample(float animation_time, ChannelSample &sample,
+                     ChannelCursor &cursor) const {
+  if (m_constant) {
+    sample = m_constant_sample;
+    return;
+  }
+  assert(get_keys_count() > 0 && "keyframes not released");
+
+  if (is_compressed()) {
+    // all components share time stamps, so one index is enough
+    sample_compressed(animation_time, sample, cursor.position);
+    return;
+  }
+
+  sample.translation = interpolate_position(animation_time, cursor.position);
+  sample.rotation = interpolate_rotation(animation_time, cursor.rotation);
+  sample.scaling = interpolate_scaling(animation_time, cursor.scale);
+  sample.transformation = utility::compose_transformation(
+      sample.translation, sample.rotation, sample.scaling);
+}
+
+void Channel::sample_first_keys(ChannelSample &sample) const {
+  if (is_compressed()) {
+    sample.translation =
+        quantization::dequantize(m_quantized_positions[0], m_positions_range);
+    sample.rotation = quantization::dequantize(m_quantized_rotations[0]);
+    sample.scaling =
+        quantization::dequantize(m_quantized_scales[0], m_scales_range);
+  } else {
+    sample.translation = m_positions[0].position;
+    sample.rotation = glm::normalize(m_rotations[0].orientation);
+    sample.scaling = m_scales[0].scale;
+  }
+  sample.transformation = utility::compose_transformation(
+      sample.translation, sample.rotation, sample.scaling);
 }
 
-void Channel::update(float animation_time) {
-  auto translation = interpolate_position(animation_time);
-  auto rotation = interpolate_rotation(animation_time);
-  auto scaling = interpolate_scaling(animation_time);
-  m_transformation = translation * rotation * scaling;
+void Channel::sample_compressed(float animation_time, ChannelSample &sample,
+                                unsigned int &hint) const {
+  unsigned int p0Index = find_key_index(m_times, animation_time, hint);
+  unsigned int p1Index =
+      std::min<unsigned int>(p0Index + 1, m_times.size() - 1);
+  float factor =
+      p0Index != p1Index
+          ? get_factor(m_times[p0Index], m_times[p1Index], animation_time)
+          : 0.0f;
+
+  sample.translation = glm::mix(
+      quantization::dequantize(m_quantized_positions[p0Index],
+                               m_positions_range),
+      quantization::dequantize(m_quantized_positions[p1Index],
+                               m_positions_range),
+      factor);
+  sample.rotation = glm::normalize(
+      glm::slerp(quantization::dequantize(m_quantized_rotations[p0Index]),
+                 quantization::dequantize(m_quantized_rotations[p1Index]),
+                 factor));
+  sample.scaling = glm::mix(
+      quantization::dequantize(m_quantized_scales[p0Index], m_scales_range),
+      quantization::dequantize(m_quantized_scales[p1Index], m_scales_range),
+      factor);
+  sample.transformation = utility::compose_transformation(
+      sample.translation, sample.rotation, sample.scaling);
 }
 
-int Channel::get_position_index(float animation_time) const {
-  for (int index = 0; index < m_positions.size() - 1; ++index) {
-    if (animation_time < m_positions[index + 1].timeStamp)
-      return index;
+bool Channel::compress(const CompressionTolerance &tolerance) {
+  if (is_compressed()) {
+    return true;
+  }
+
+  // time stamps of all the components, every component is sampled at each
+  // of them, so keyframes of different components can share time stamps
+  std::set<float> all_unique_time_stamps;
+  for (const auto &key : m_positions) {
+    all_unique_time_stamps.insert(key.timeStamp);
+  }
+  for (const auto &key : m_rotations) {
+    all_unique_time_stamps.insert(key.timeStamp);
+  }
+  for (const auto &key : m_scales) {
+    all_unique_time_stamps.insert(key.timeStamp);
+  }
+
+  std::vector<float> times(all_unique_time_stamps.begin(),
+                           all_unique_time_stamps.end());
+  std::vector<glm::vec3> translations;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scalings;
+  translations.reserve(times.size());
+  rotations.reserve(times.size());
+  scalings.reserve(times.size());
+
+  ChannelSample sample;
+  ChannelCursor cursor;
+  for (float time : times) {
+    this->sample(time, sample, cursor);
+    translations.push_back(sample.translation);
+    rotations.push_back(sample.rotation);
+    scalings.push_back(sample.scaling);
   }
-  return m_positions.size() - 1;
+
+  auto positions_range = quantization::get_range(translations);
+  auto scales_range = quantization::get_range(scalings);
+
+  std::vector<QuantizedVec3> quantized_positions;
+  std::vector<QuantizedQuat> quantized_rotations;
+  std::vector<QuantizedVec3> quantized_scales;
+  quantized_positions.reserve(times.size());
+  quantized_rotations.reserve(times.size());
+  quantized_scales.reserve(times.size());
+
+  for (unsigned int i = 0; i < times.size(); ++i) {
+    quantized_positions.push_back(
+        quantization::quantize(translations[i], positions_range));
+    quantized_rotations.push_back(quantization::quantize(rotations[i]));
+    quantized_scales.push_back(
+        quantization::quantize(scalings[i], scales_range));
+
+    if (quantization::get_vector_error(
+            translations[i],
+            quantization::dequantize(quantized_positions[i],
+                                     positions_range)) >
+            tolerance.translation ||
+        quantization::get_rotation_error(
+            rotations[i], quantization::dequantize(quantized_rotations[i])) >
+            tolerance.rotation ||
+        quantization::get_vector_error(
+            scalings[i],
+            quantization::dequantize(quantized_scales[i], scales_range)) >
+            tolerance.scaling) {
+      return false;
+    }
+  }
+
+  m_times = std::move(times);
+  m_quantized_positions = std::move(quantized_positions);
+  m_quantized_rotations = std::move(quantized_rotations);
+  m_quantized_scales = std::move(quantized_scales);
+  m_positions_range = positions_range;
+  m_scales_range = scales_range;
+
+  // release full precision keyframes
+  std::vector<KeyPosition>().swap(m_positions);
+  std::vector<KeyRotation>().swap(m_rotations);
+  std::vector<KeyScale>().swap(m_scales);
+  return true;
 }
 
-int Channel::get_rotation_index(float animation_time) const {
-  for (int index = 0; index < m_rotations.size() - 1; ++index) {
-    if (animation_time < m_rotations[index + 1].timeStamp)
-      return index;
+void Channel::reduce(const CompressionTolerance &tolerance) {
+  if (is_compressed()) {
+    return;
+  }
+
+  reduce_keys(
+      m_positions, tolerance.translation,
+      [](const KeyPosition &key) { return key.position; },
+      [](const glm::vec3 &v1, const glm::vec3 &v2, float factor) {
+        return glm::mix(v1, v2, factor);
+      },
+      quantization::get_vector_error);
+  reduce_keys(
+      m_rotations, tolerance.rotation,
+      [](const KeyRotation &key) { return glm::normalize(key.orientation); },
+      [](const glm::quat &q1, const glm::quat &q2, float factor) {
+        return glm::normalize(glm::slerp(q1, q2, factor));
+      },
+      quantization::get_rotation_error);
+  reduce_keys(
+      m_scales, tolerance.scaling,
+      [](const KeyScale &key) { return key.scale; },
+      [](const glm::vec3 &v1, const glm::vec3 &v2, float factor) {
+        return glm::mix(v1, v2, factor);
+      },
+      quantization::get_vector_error);
+
+  update_constant();
+}
+
+void Channel::update_constant() {
+  m_constant = m_positions.size() == 1 && m_rotations.size() == 1 &&
+               m_scales.size() == 1;
+  if (m_constant) {
+    sample_first_keys(m_constant_sample);
   }
-  return m_rotations.size() - 1;
 }
 
-int Channel::get_scale_index(float animation_time) const {
-  for (int index = 0; index < m_scales.size() - 1; ++index) {
-    if (animation_time < m_scales[index + 1].timeStamp)
-      return index;
+void Channel::release_keys() {
+  if (m_constant) {
+    return;
   }
-  return m_scales.size() - 1;
+
+  std::vector<KeyPosition>().swap(m_positions);
+  std::vector<KeyRotation>().swap(m_rotations);
+  std::vector<KeyScale>().swap(m_scales);
+  std::vector<float>().swap(m_times);
+  std::vector<QuantizedVec3>().swap(m_quantized_positions);
+  std::vector<QuantizedQuat>().swap(m_quantized_rotations);
+  std::vector<QuantizedVec3>().swap(m_quantized_scales);
+}
+
+unsigned int Channel::get_keys_count() const {
+  return m_positions.size() + m_rotations.size() + m_scales.size() +
+         3 * m_times.size();
+}
+
+unsigned int Channel::get_memory_size() const {
+  return m_positions.size() * sizeof(KeyPosition) +
+         m_rotations.size() * sizeof(KeyRotation) +
+         m_scales.size() * sizeof(KeyScale) + m_times.size() * sizeof(float) +
+         m_quantized_positions.size() * sizeof(QuantizedVec3) +
+         m_quantized_rotations.size() * sizeof(QuantizedQuat) +
+         m_quantized_scales.size() * sizeof(QuantizedVec3) +
+         (is_compressed() ? 2 * sizeof(QuantizationRange) : 0);
+}
+
+int Channel::get_position_index(float animation_time,
+                                unsigned int &hint) const {
+  return find_key_index(m_positions, animation_time, hint);
+}
+
+int Channel::get_rotation_index(float animation_time,
+                                unsigned int &hint) const {
+  return find_key_index(m_rotations, animation_time, hint);
+}
+
+int Channel::get_scale_index(float animation_time, unsigned int &hint) const {
+  return find_key_index(m_scales, animation_time, hint);
 }
 
 float Channel::get_factor(float last_time, float next_time,
@@ -85,41 +386,33 @@ float Channel::get_factor(float last_time, float next_time,
   return factor;
 }
 
-glm::mat4 Channel::interpolate_position(float animation_time) {
+glm::vec3 Channel::interpolate_position(float animation_time,
+                                        unsigned int &hint) const {
   if (1 == m_positions.size()) {
-    m_translation = m_positions[0].position;
-    return glm::translate(glm::mat4(1.0f), m_positions[0].position);
+    return m_positions[0].position;
   }
 
-  int p0Index = get_position_index(animation_time);
+  int p0Index = get_position_index(animation_time, hint);
   if (p0Index == m_positions.size() - 1) {
-    m_translation = m_positions.back().position;
-    return glm::translate(glm::mat4(1.0f), m_positions.back().position);
+    return m_positions.back().position;
   }
   int p1Index = p0Index + 1;
   float scaleFactor =
       get_factor(m_positions[p0Index].timeStamp, m_positions[p1Index].timeStamp,
                  animation_time);
-  glm::vec3 finalPosition =
-      glm::mix(m_positions[p0Index].position, m_positions[p1Index].position,
-               scaleFactor);
-
-  m_translation = finalPosition;
-  return glm::translate(glm::mat4(1.0f), finalPosition);
+  return glm::mix(m_positions[p0Index].position, m_positions[p1Index].position,
+                  scaleFactor);
 }
 
-glm::mat4 Channel::interpolate_rotation(float animation_time) {
+glm::quat Channel::interpolate_rotation(float animation_time,
+                                        unsigned int &hint) const {
   if (1 == m_rotations.size()) {
-    auto rotation = glm::normalize(m_rotations[0].orientation);
-    m_rotation = rotation;
-    return glm::toMat4(rotation);
+    return glm::normalize(m_rotations[0].orientation);
   }
 
-  int p0Index = get_rotation_index(animation_time);
+  int p0Index = get_rotation_index(animation_time, hint);
   if (p0Index == m_rotations.size() - 1) {
-    auto rotation = glm::normalize(m_rotations.back().orientation);
-    m_rotation = rotation;
-    return glm::toMat4(rotation);
+    return glm::normalize(m_rotations.back().orientation);
   }
   int p1Index = p0Index + 1;
   float scaleFactor =
@@ -128,27 +421,22 @@ glm::mat4 Channel::interpolate_rotation(float animation_time) {
   glm::quat finalRotation =
       glm::slerp(m_rotations[p0Index].orientation,
                  m_rotations[p1Index].orientation, scaleFactor);
-  finalRotation = glm::normalize(finalRotation);
-  m_rotation = finalRotation;
-  return glm::toMat4(finalRotation);
+  return glm::normalize(finalRotation);
 }
 
-glm::mat4 Channel::interpolate_scaling(float animation_time) {
+glm::vec3 Channel::interpolate_scaling(float animation_time,
+                                       unsigned int &hint) const {
   if (1 == m_scales.size()) {
-    m_scaling = m_scales[0].scale;
-    return glm::scale(glm::mat4(1.0f), m_scales[0].scale);
+    return m_scales[0].scale;
   }
 
-  int p0Index = get_scale_index(animation_time);
+  int p0Index = get_scale_index(animation_time, hint);
   if (p0Index == m_scales.size() - 1) {
-    m_scaling = m_scales.back().scale;
-    return glm::scale(glm::mat4(1.0f), m_scales.back().scale);
+    return m_scales.back().scale;
   }
   int p1Index = p0Index + 1;
   float scaleFactor = get_factor(m_scales[p0Index].timeStamp,
                                  m_scales[p1Index].timeStamp, animation_time);
-  glm::vec3 finalScale =
-      glm::mix(m_scales[p0Index].scale, m_scales[p1Index].scale, scaleFactor);
-  m_scaling = finalScale;
-  return glm::scale(glm::mat4(1.0f), finalScale);
+  return glm::mix(m_scales[p0Index].scale, m_scales[p1Index].scale,
+                  scaleFactor);
 }
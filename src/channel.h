@@ -1,6 +1,7 @@
 #ifndef _CHANNEL_H_
 #define _CHANNEL_H_
 
+#include "quantization.h"
 #include <assimp/anim.h>
 #include <glm/ext/vector_float3.hpp>
 #include <glm/fwd.hpp>
@@ -23,6 +24,35 @@ struct KeyScale {
   float timeStamp;
 };
 
+// channel's local transformation at some animation time
+// it is owned by the caller, so channels stay immutable and can be sampled
+// by multiple mesh instances at the same time
+struct ChannelSample {
+  glm::vec3 translation;
+  glm::quat rotation;
+  glm::vec3 scaling;
+  glm::mat4 transformation;
+};
+
+// keyframe indices found by the last channel sampling
+// they are used as a starting point for the next keyframe lookup, so
+// sampling an animation that is played forward or backward finds keyframes
+// in constant time
+struct ChannelCursor {
+  unsigned int position = 0;
+  unsigned int rotation = 0;
+  unsigned int scale = 0;
+};
+
+// maximum error allowed when keyframes are reduced or compressed
+struct CompressionTolerance {
+  // in model units
+  float translation = 0.01f;
+  // angle in radians
+  float rotation = 0.001f;
+  float scaling = 0.001f;
+};
+
 class Channel {
 private:
   std::string m_name;
@@ -30,21 +60,26 @@ private:
   std::vector<KeyRotation> m_rotations;
   std::vector<KeyScale> m_scales;
 
-  glm::vec3 m_translation;
-  glm::quat m_rotation;
-  glm::vec3 m_scaling;
-  glm::mat4 m_transformation;
+  // compressed keyframes, used instead of the keyframes above if the channel
+  // is compressed
+  // translation, rotation and scaling share the time stamps
+  std::vector<float> m_times;
+  std::vector<QuantizedVec3> m_quantized_positions;
+  std::vector<QuantizedQuat> m_quantized_rotations;
+  std::vector<QuantizedVec3> m_quantized_scales;
+  QuantizationRange m_positions_range;
+  QuantizationRange m_scales_range;
+
+  // true if translation, rotation and scaling have only one keyframe
+  // constant channel is sampled only once, when it's created
+  bool m_constant = false;
+  ChannelSample m_constant_sample;
 
 public:
   Channel(const aiNodeAnim *channel);
   Channel(std::string name, std::vector<KeyPosition> positions,
           std::vector<KeyRotation> rotations, std::vector<KeyScale> scales);
 
-  const glm::mat4 &get_local_transform() const { return m_transformation; }
-  const glm::vec3 &get_local_translation() const { return m_translation; }
-  const glm::vec3 &get_local_scaling() const { return m_scaling; }
-  const glm::quat &get_local_rotation() const { return m_rotation; }
-
   const std::vector<KeyPosition> &positions_channel() const {
     return m_positions;
   };
@@ -53,17 +88,50 @@ public:
   };
   const std::vector<KeyScale> &scales_channel() const { return m_scales; };
 
-  void update(float animation_time);
-  int get_position_index(float animation_time) const;
-  int get_rotation_index(float animation_time) const;
-  int get_scale_index(float animation_time) const;
+  // sample local transformation at the given time into the given sample
+  // cursor keeps keyframe indices of the previous sampling and gets updated
+  void sample(float animation_time, ChannelSample &sample,
+              ChannelCursor &cursor) const;
+  // sample the first keyframe of translation, rotation and scaling
+  void sample_first_keys(ChannelSample &sample) const;
+
+  // quantize keyframes and release the full precision ones
+  // return false and keep the channel uncompressed if the compression error
+  // is greater than the tolerance
+  bool compress(const CompressionTolerance &tolerance);
+  bool is_compressed() const { return !m_times.empty(); }
+  // release keyframes of a channel that is sampled from resampled frames,
+  // channel can't be sampled afterwards, constant channel keeps its keyframes
+  void release_keys();
+  // return size of the keyframes in bytes
+  unsigned int get_memory_size() const;
+
+  // remove keyframes that can be interpolated from their neighbours within
+  // the tolerance, component whose keyframes are all equal within the
+  // tolerance is left with one keyframe
+  void reduce(const CompressionTolerance &tolerance);
+  bool is_constant() const { return m_constant; }
+  unsigned int get_keys_count() const;
+
+private:
+  void update_constant();
+
+  void sample_compressed(float animation_time, ChannelSample &sample,
+                         unsigned int &hint) const;
+
+public:
+  int get_position_index(float animation_time, unsigned int &hint) const;
+  int get_rotation_index(float animation_time, unsigned int &hint) const;
+  int get_scale_index(float animation_time, unsigned int &hint) const;
 
   float get_factor(float last_time, float next_time,
                    float animation_time) const;
 
-  glm::mat4 interpolate_position(float animation_time);
-  glm::mat4 interpolate_rotation(float animation_time);
-  glm::mat4 interpolate_scaling(float animation_time);
+  glm::vec3 interpolate_position(float animation_time,
+                                 unsigned int &hint) const;
+  glm::quat interpolate_rotation(float animation_time,
+                                 unsigned int &hint) const;
+  glm::vec3 interpolate_scaling(float animation_time, unsigned int &hint) const;
 };
 
 #endif /* _CHANNEL_H_ */
@@ -0,0 +1,116 @@
+// micro-benchmark of the keyframe lookup of Channel
+// compares the cursor lookup with the linear scan it replaced on a long clip
+// played forward, backward and with random jumps
+#include "channel.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+const unsigned int KEYS_COUNT = 2000;
+const float TICKS_PER_KEY = 1.0f;
+// animation time step of one frame, a few frames fall between two keyframes
+const float FRAME_STEP = 0.3f;
+const unsigned int SAMPLES_COUNT = 1000000;
+
+Channel create_channel() {
+  std::vector<KeyPosition> positions;
+  std::vector<KeyRotation> rotations;
+  std::vector<KeyScale> scales;
+  for (unsigned int i = 0; i < KEYS_COUNT; ++i) {
+    float time = i * TICKS_PER_KEY;
+    positions.push_back({glm::vec3(i, 0.0f, 0.0f), time});
+    rotations.push_back({glm::quat(1.0f, 0.0f, 0.0f, 0.0f), time});
+    scales.push_back({glm::vec3(1.0f), time});
+  }
+  return Channel("bench", std::move(positions), std::move(rotations),
+                 std::move(scales));
+}
+
+// keyframe lookup of Channel before the cursor was added
+int linear_scan(const std::vector<KeyPosition> &positions,
+                float animation_time) {
+  for (int index = 0; index < positions.size() - 1; ++index) {
+    if (animation_time < positions[index + 1].timeStamp)
+      return index;
+  }
+  return positions.size() - 1;
+}
+
+std::vector<float> forward_times(float duration) {
+  std::vector<float> times(SAMPLES_COUNT);
+  for (unsigned int i = 0; i < SAMPLES_COUNT; ++i) {
+    times[i] = std::fmod(i * FRAME_STEP, duration);
+  }
+  return times;
+}
+
+std::vector<float> reverse_times(float duration) {
+  std::vector<float> times = forward_times(duration);
+  for (auto &time : times) {
+    time = duration - time;
+  }
+  return times;
+}
+
+std::vector<float> jump_times(float duration) {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> distribution(0.0f, duration);
+  std::vector<float> times(SAMPLES_COUNT);
+  for (auto &time : times) {
+    time = distribution(generator);
+  }
+  return times;
+}
+
+// run lookup for all the times, return nanoseconds per lookup
+template <typename Lookup>
+double measure(const std::vector<float> &times, Lookup lookup,
+               long long &checksum) {
+  auto start = std::chrono::steady_clock::now();
+  for (float time : times) {
+    checksum += lookup(time);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         times.size();
+}
+
+void run(const std::string &name, const Channel &channel,
+         const std::vector<float> &times) {
+  long long linear_checksum = 0;
+  double linear_time = measure(
+      times,
+      [&](float time) {
+        return linear_scan(channel.positions_channel(), time);
+      },
+      linear_checksum);
+
+  long long cursor_checksum = 0;
+  unsigned int hint = 0;
+  double cursor_time = measure(
+      times,
+      [&](float time) { return channel.get_position_index(time, hint); },
+      cursor_checksum);
+
+  std::cout << name << ": linear " << linear_time << " ns, cursor "
+            << cursor_time << " ns, speedup " << linear_time / cursor_time
+            << (linear_checksum == cursor_checksum ? "" : " (results differ)")
+            << std::endl;
+}
+} // namespace
+
+int main() {
+  Channel channel = create_channel();
+  float duration = (KEYS_COUNT - 1) * TICKS_PER_KEY;
+
+  std::cout << KEYS_COUNT << " keyframes, " << SAMPLES_COUNT
+            << " lookups per playback" << std::endl;
+  run("forward", channel, forward_times(duration));
+  run("reverse", channel, reverse_times(duration));
+  run("jump", channel, jump_times(duration));
+  return 0;
+}
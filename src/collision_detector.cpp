@@ -39,8 +39,15 @@ std::optional<glm::vec3> CollistionDetector::collision_vector(
 
   // collision with static objects
   for (auto static_object_ptr : m_static_objects) {
-    auto current_vector = collision_vector(dynamic_object->bvh().volume,
-                                           static_object_ptr->bvh());
+    // approximate volume is tested against the whole static object first,
+    // exact volume is built only if they intersect
+    if (dynamic_object->bvh().volume.intersects(
+            static_object_ptr->bvh().volume) == glm::vec3(0, 0, 0)) {
+      continue;
+    }
+
+    auto current_vector = collision_vector(
+        dynamic_object->exact_bvh().volume, static_object_ptr->bvh());
 
     if (!current_vector || !update_result(result_vector, *current_vector)) {
       // unsolvable collision
@@ -56,8 +63,14 @@ std::optional<glm::vec3> CollistionDetector::collision_vector(
       continue;
     }
 
-    auto current_vector = dynamic_object->bvh().volume.intersects(
-        dynamic_object_ptr->bvh().volume);
+    // approximate volumes are tested first, exact ones only if they intersect
+    if (dynamic_object->bvh().volume.intersects(
+            dynamic_object_ptr->bvh().volume) == glm::vec3(0, 0, 0)) {
+      continue;
+    }
+
+    auto current_vector = dynamic_object->exact_bvh().volume.intersects(
+        dynamic_object_ptr->exact_bvh().volume);
 
     if (!update_result(result_vector, current_vector)) {
       // unsolvable collision
@@ -14,7 +14,8 @@ public:
   CollisionObject() = default;
 
   CollisionObject(const CollisionObject &other)
-      : m_bvh_root(nullptr), m_needs_update(true) {}
+      : m_bvh_root(nullptr), m_needs_update(true), m_exact_bvh_root(nullptr),
+        m_exact_needs_update(true) {}
 
   virtual ~CollisionObject() {}
 
@@ -29,11 +30,28 @@ public:
     return *m_bvh_root;
   }
 
-  void clear_bounding_volumes() { m_needs_update = true; }
+  // bounding volumes used when precision matters more than speed (nullptr if
+  // bvh is already exact)
+  virtual std::unique_ptr<BVHNode<T>> get_exact_bvh() const { return nullptr; }
+
+  const BVHNode<T> &exact_bvh() const {
+    if (m_exact_needs_update) {
+      m_exact_bvh_root = get_exact_bvh();
+      m_exact_needs_update = false;
+    }
+    return m_exact_bvh_root ? *m_exact_bvh_root : bvh();
+  }
+
+  void clear_bounding_volumes() {
+    m_needs_update = true;
+    m_exact_needs_update = true;
+  }
 
 private:
   mutable std::unique_ptr<BVHNode<T>> m_bvh_root;
   mutable bool m_needs_update = true;
+  mutable std::unique_ptr<BVHNode<T>> m_exact_bvh_root;
+  mutable bool m_exact_needs_update = true;
 };
 
 #endif /* _COLLISION_OBJECT_H_ */
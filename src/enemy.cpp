@@ -5,9 +5,11 @@
 #include "level_manager.h"
 #include "player.h"
 
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtx/vector_angle.hpp>
 
+#include <cmath>
 #include <iostream>
 
 // -------------- static vars ----------------------------
@@ -21,6 +23,21 @@ const glm::vec3 Enemy::FRONT_DIRECTION = glm::vec3(-1, 0, 0);
 const float Enemy::SCALING_FACTOR = 0.01;
 // when player is under domain
 const short Enemy::PLAYER_CLOSE_THRESHOLD = 18;
+// enemy's animations are resampled on import so that all the enemies can
+// sample them without searching for keyframes, and reduced and compressed so
+// that more animations fit in memory
+// all the enemies share baked animations, so that the cost of evaluating
+// the same animation doesn't grow with the number of enemies
+// enemies are skinned with dual quaternions and drawn instanced from the
+// bones buffers
+const AnimationImportSettings Enemy::ANIMATION_SETTINGS = [] {
+  AnimationImportSettings settings;
+  settings.sample_rate = 30.0f;
+  settings.compress = true;
+  settings.reduce = true;
+  settings.bake_rate = 60.0f;
+  return settings;
+}();
 // ------------------------------------------------------
 
 // after how many ticks to update behavior tree
@@ -72,7 +89,18 @@ bool Enemy::is_target_shot(float distance) {
 
 AnimatedMesh &Enemy::get_animated_mesh_instance() {
   // instantiated on first use
-  static AnimatedMesh s_animated_mesh{"../res/models/enemy/enemy.gltf"};
+  static AnimatedMesh s_animated_mesh = []() {
+    AnimatedMesh animated_mesh{"../res/models/enemy/enemy.gltf",
+                               Enemy::ANIMATION_SETTINGS};
+    // nodes used by the ai are evaluated even when the enemy is not animated
+    animated_mesh.set_socket_nodes(
+        {Enemy::GUN, Enemy::LEFT_EYE_BONE, Enemy::SPINE_BONE});
+    // spine follows the target on top of the animations
+    animated_mesh.add_pose_layer(Enemy::SPINE_BONE, PoseLayerMode::Additive);
+    // shoulders and spine twist without volume loss
+    animated_mesh.set_skinning_mode(SkinningMode::DualQuaternion);
+    return animated_mesh;
+  }();
   return s_animated_mesh;
 }
 
@@ -86,8 +114,9 @@ unsigned int Enemy::get_id() {
 Enemy::Enemy(LevelManager &level_manger, const glm::vec3 &position,
              float degreesXZ)
     : AnimatedMesh(Enemy::get_animated_mesh_instance()), m_id(Enemy::get_id()),
-      m_level_manager(level_manger), m_state_machine(*this), m_bt(*this),
-      m_tick_count(0),
+      m_spine_layer(m_skinned_mesh.get_pose_layer(Enemy::SPINE_BONE)),
+      m_spine_angle(0), m_spine_base_angle(0), m_level_manager(level_manger),
+      m_state_machine(*this), m_bt(*this), m_tick_count(0),
       m_effects_to_render(m_skinned_mesh.get_render_object_ids(Enemy::FLASH)) {
   init_cache();
   set_transformation(position, degreesXZ);
@@ -95,6 +124,8 @@ Enemy::Enemy(LevelManager &level_manger, const glm::vec3 &position,
 
 Enemy::Enemy(const Enemy &other)
     : AnimatedMesh(other), m_id(other.m_id),
+      m_spine_layer(other.m_spine_layer), m_spine_angle(other.m_spine_angle),
+      m_spine_base_angle(other.m_spine_base_angle),
       m_level_manager(other.m_level_manager),
       // it is important to create a new state
       m_state_machine(*this), m_bt(*this), m_tick_count(other.m_tick_count),
@@ -109,6 +140,7 @@ void Enemy::reset(const glm::vec3 &position, float degreesXZ) {
   m_bt.reset();
 
   init_cache();
+  set_spine_angle(0);
 
   set_transformation(position, degreesXZ);
 }
@@ -231,31 +263,52 @@ std::pair<glm::vec3, glm::vec3> Enemy::get_eye_player_direction() const {
   return {std::move(eye_O), std::move(eye_player_direction_reduced)};
 }
 
-void Enemy::set_bones_position(StateMachine::Position position) {
-  m_skinned_mesh.get_bones_for_position(StateMachine::position_name(position));
+void Enemy::set_bones_position(PositionId position_id) {
+  m_skinned_mesh.get_bones_for_position(position_id);
+  set_spine_angle(0);
+  sample_spine_base_angle();
 }
 
 void Enemy::create_transition_animation(const std::string &animation_name,
                                         float animation_duration,
                                         const std::string &bone_to_ignore) {
   // create "transition" animation in animated mesh that transforms it from
-  // a current position to the first frame of the given animation/position
-  // ignore spine bone if needed to control it manually (during attacking state)
+  // a current position to the first frame of the given animation
   m_skinned_mesh.create_transition_animation(animation_name, animation_duration,
                                              bone_to_ignore);
+  on_transition_created(bone_to_ignore);
+}
+
+void Enemy::create_transition_animation(PositionId position_id,
+                                        float animation_duration,
+                                        const std::string &bone_to_ignore) {
+  // ignore spine bone if needed to control it manually (during attacking state)
+  m_skinned_mesh.create_transition_animation(position_id, animation_duration,
+                                             bone_to_ignore);
+  on_transition_created(bone_to_ignore);
+}
+
+void Enemy::on_transition_created(const std::string &ignored_bone) {
+  if (ignored_bone != Enemy::SPINE_BONE) {
+    // spine rotation is merged into the transition which brings the spine
+    // back to the animated orientation
+    m_spine_angle = 0;
+  } else {
+    // spine keeps its current animated orientation during the transition
+    sample_spine_base_angle();
+  }
 }
 
-void Enemy::render(Shader &shader, Shader &effects_shader,
-                   Shader &bounding_box_shader, const Camera &camera,
-                   const Light &light) const {
-  // render everything but effect objects
-  AnimatedMesh::render(shader, camera, light, m_effects_to_render,
-                       true /* exclude */);
+void Enemy::submit(RenderQueue &queue, Shader &shader, Shader &effects_shader,
+                   Shader &bounding_box_shader, const Camera &camera) const {
+  // submit everything but effect objects
+  AnimatedMesh::submit(queue, RenderPass::Opaque, shader, camera,
+                       m_effects_to_render, true /* exclude */);
 
   if (is_shooting()) {
-    // render only effect objects
-    AnimatedMesh::render(effects_shader, camera, light, m_effects_to_render,
-                         false /* exclude */);
+    // submit only effect objects
+    AnimatedMesh::submit(queue, RenderPass::Effects, effects_shader, camera,
+                         m_effects_to_render, false /* exclude */);
   }
 
 #ifdef FPS_DEBUG
@@ -368,73 +421,16 @@ bool Enemy::is_player_close(short threshold) const {
          threshold * threshold;
 }
 
-float Enemy::get_spine_angle() const {
-  if (m_spine_angle_cache.second) {
-    // if cache is valid return it
-    return m_spine_angle_cache.first;
+void Enemy::sample_spine_base_angle() {
+  // twist of the animated spine rotation around y-axis of its parent
+  glm::quat rotation = m_skinned_mesh.node_animated_rotation(Enemy::SPINE_BONE);
+  m_spine_base_angle = glm::degrees(2.0f * std::atan2(rotation.y, rotation.w));
+  // keep the angle in [-180, 180]
+  if (m_spine_base_angle > 180.0f) {
+    m_spine_base_angle -= 360.0f;
+  } else if (m_spine_base_angle < -180.0f) {
+    m_spine_base_angle += 360.0f;
   }
-
-  // bone points along y-axis
-  // spine orientation is got by first rotating spine around y-axis (of parent's
-  // system) then rotated it to point in some direction, after that spine is
-  // translated (not important for finding the spine angle)
-  // we want to find spine rotation angle around y-axis (XZ palne)
-
-  //   y           y
-  //   |           |
-  //   |           |
-  //   |           |
-  //   |   spine_O -------- spine bone system
-  //   |
-  //   |
-  // O ------------- spine's parent bone system
-
-  // spine transformation in its parent bone space
-  const auto &spine_local_transformation =
-      m_skinned_mesh.node_local_transformation(Enemy::SPINE_BONE);
-
-  // ----- spine's parent space ----
-  glm::vec3 O = glm::vec3(0, 0, 0);
-  glm::vec3 Y = glm::vec3(0, 1, 0);
-  glm::vec3 X = glm::vec3(1, 0, 0);
-  // -------------------------------
-
-  // spine position in its parent system
-  glm::vec3 spine_O = spine_local_transformation * glm::vec4(O, 1);
-  // spine point on y-axis in its parent system
-  glm::vec3 spine_Y = spine_local_transformation * glm::vec4(Y, 1);
-  glm::vec3 spine_X = spine_local_transformation * glm::vec4(X, 1);
-  auto spine_OY = spine_Y - spine_O;
-  auto spine_OX = spine_X - spine_O;
-
-  // find angle between parent's OY axis vector and spoine's OY vector in
-  // parent's space
-  float OY_angle = glm::angle(Y /* OY */, spine_OY);
-
-  // find how spine's system would be oriented (translation is not important) if
-  // it was not rotated around y-axis before its y-axis got transformed to point
-  // in spine_OY direction (we are interested only in x-axis of such system
-  // because we want to find rotation angle in XZ plane)
-  // rotate x-axis for OY_angle angle around line trough origin that is
-  // perpendicular to OY and spine_OY
-  auto fixed_spine_X =
-      glm::rotate(X, OY_angle, glm::cross(Y /* OY */, spine_OY));
-  // fixed_spine_O = O
-
-  // find oriented angle between non rotated spine's x-axis and spine's x-axis
-  float angle = glm::degrees(glm::orientedAngle(
-      // already normalized fixed_spine_OX
-      fixed_spine_X,
-      // already normalized
-      spine_OX,
-      // reference in order to determine sign for oriented angle
-      glm::vec3(0, 1, 0)));
-
-  // refresh a cache
-  m_spine_angle_cache.first = angle;
-  m_spine_angle_cache.second = true;
-
-  return angle;
 }
 
 float Enemy::get_delta_spine_angle(float delta_time) const {
@@ -443,19 +439,20 @@ float Enemy::get_delta_spine_angle(float delta_time) const {
     return 0;
   }
 
-  float spine_angle = get_spine_angle();
-
   float delta_angle = (aim == Enemy::Aiming::Left)
                           ? SPINE_ROTATION_SPEED * delta_time
                           : -SPINE_ROTATION_SPEED * delta_time;
 
+  // limits are checked against the absolute spine angle, so the animated
+  // spine orientation counts towards them
+  float spine_angle = m_spine_base_angle + m_spine_angle;
   if (aim == Enemy::Aiming::Left) {
     if (spine_angle + delta_angle > SPINE_ANGLE_MAX) {
-      delta_angle = SPINE_ANGLE_MAX - spine_angle;
+      delta_angle = std::max(SPINE_ANGLE_MAX - spine_angle, 0.0f);
     }
   } else {
     if (spine_angle + delta_angle < SPINE_ANGLE_MIN) {
-      delta_angle = SPINE_ANGLE_MIN - spine_angle;
+      delta_angle = std::min(SPINE_ANGLE_MIN - spine_angle, 0.0f);
     }
   }
 
@@ -463,7 +460,7 @@ float Enemy::get_delta_spine_angle(float delta_time) const {
 }
 
 bool Enemy::can_rotate_spine(bool left) const {
-  float angle = get_spine_angle();
+  float angle = m_spine_base_angle + m_spine_angle;
   // rotating left increases spine angle, while rotating right decreases it
   return left ? angle < SPINE_ANGLE_MAX : angle > SPINE_ANGLE_MIN;
 }
@@ -536,15 +533,18 @@ void Enemy::rotate_spine(float delta_time) {
   float delta_angle = get_delta_spine_angle(delta_time);
 
   if (delta_angle != 0) {
-    // update the cache
-    m_spine_angle_cache.first += delta_angle;
-    // rotate the spine bone
-    m_skinned_mesh.rotate_bone(
-        Enemy::SPINE_BONE,
-        glm::rotate(glm::radians(delta_angle), glm::vec3(0, 1, 0)));
+    set_spine_angle(m_spine_angle + delta_angle);
   }
 }
 
+void Enemy::set_spine_angle(float angle) {
+  m_spine_angle = angle;
+  // spine is rotated around y-axis of its parent on top of the animated pose
+  m_skinned_mesh.set_pose_layer(
+      m_spine_layer,
+      glm::angleAxis(glm::radians(m_spine_angle), glm::vec3(0, 1, 0)));
+}
+
 std::optional<StateMachine::ActionStatus>
 Enemy::get_action_status(StateMachine::Action action) const {
   return m_state_machine.get_action_status(action);
@@ -599,10 +599,7 @@ void Enemy::update(float current_time) {
   m_state_machine.update(m_timer.tick(current_time));
 }
 
-void Enemy::init_cache() {
-  m_spine_angle_cache = {0, false};
-  m_under_aim_during_chasing = false;
-}
+void Enemy::init_cache() { m_under_aim_during_chasing = false; }
 
 bool Enemy::is_shooting() const { return m_state_machine.m_is_shooting; }
 void Enemy::stop_shooting() { m_state_machine.m_is_shooting = false; }
@@ -48,7 +48,7 @@ public:
 
   // ---------------------- animated mesh interface ---------------------------
   // set enemy's bones to be in some position
-  void set_bones_position(StateMachine::Position position);
+  void set_bones_position(PositionId position_id);
 
   // create "transition" animation in animated mesh that transforms it from
   // a current position to the first frame of the given animation/position
@@ -56,10 +56,13 @@ public:
   void create_transition_animation(const std::string &animation_name,
                                    float animation_duration,
                                    const std::string &bone_to_ignore = "");
+  void create_transition_animation(PositionId position_id,
+                                   float animation_duration,
+                                   const std::string &bone_to_ignore = "");
 
-  void render(Shader &shader, Shader &effects_shader,
-              Shader &bounding_box_shader, const Camera &camera,
-              const Light &light) const;
+  // add draw items to the queue, effects are drawn in the effects pass
+  void submit(RenderQueue &queue, Shader &shader, Shader &effects_shader,
+              Shader &bounding_box_shader, const Camera &camera) const;
   // --------------------------------------------------------------------------
 
   // ------------------ spine control -----------------------------
@@ -141,8 +144,17 @@ private:
   void render_eye_player_direction(Shader &bounding_box_shader,
                                    const Camera &camera) const;
 
-  float get_spine_angle() const;
+  // store rotation of the animated spine around y-axis of its parent, sampled
+  // once when the pose the spine layer is applied on changes
+  void sample_spine_base_angle();
+  // update spine angles after a transition that ignores the given bone was
+  // created
+  void on_transition_created(const std::string &ignored_bone);
+  // return change of the spine layer angle, the spine angle limits are
+  // absolute (animated spine angle included)
   float get_delta_spine_angle(float delta_time) const;
+  // set spine rotation around y-axis in degrees relative to the animated pose
+  void set_spine_angle(float angle);
 
   // get angle between gun and player
   float get_aiming_angle() const;
@@ -168,6 +180,7 @@ public:
   static const float SCALING_FACTOR;
   static const std::string FLASH;
   static const short PLAYER_CLOSE_THRESHOLD;
+  static const AnimationImportSettings ANIMATION_SETTINGS;
   // -----------------------------------------------
 
   // ---------------- member vars -----------------------
@@ -176,6 +189,14 @@ private:
   static unsigned int get_id();
 
   unsigned int m_id;
+  // spine members are initialized before the state machine which sets the
+  // initial position
+  // index of the pose layer that rotates the spine
+  unsigned int m_spine_layer;
+  // spine rotation around y-axis in degrees relative to the animated pose
+  float m_spine_angle;
+  // rotation of the animated spine around y-axis in degrees
+  float m_spine_base_angle;
   // enemy's state
   StateMachine m_state_machine;
   // enemy's behavior tree
@@ -189,7 +210,6 @@ private:
   // id of effect objects to render (gun flash)
   std::vector<unsigned int> m_effects_to_render;
   // ---------------- cache -----------------------------
-  mutable std::pair<float, bool> m_spine_angle_cache;
   mutable bool m_under_aim_during_chasing;
   // ----------------------------------------------------
 };
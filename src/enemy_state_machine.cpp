@@ -22,6 +22,12 @@ std::unordered_map<StateMachine::Position, std::string>
 const std::string &StateMachine::position_name(Position position) {
   return s_positions[position];
 }
+
+PositionId StateMachine::get_position_id(Position position) const {
+  auto position_it = m_position_ids.find(position);
+  assert(position_it != m_position_ids.end() && "position is resolved");
+  return position_it->second;
+}
 // ---------------------------------------
 
 StateMachine::StateMachine(Enemy &owner)
@@ -36,6 +42,10 @@ StateMachine::StateMachine(Enemy &owner)
            {Action::Shoot,
             {owner, "shoot", Sound::Track::RifleShoot, false, 2.0f}},
            {Action::Transition, {owner, "transition", false}}}) {
+  // resolve positions once, they are set by handles
+  for (const auto &[position, name] : s_positions) {
+    m_position_ids.emplace(position, m_owner.get_position_id(name));
+  }
 
   // create Attacking, Chasing, Patrolling and Dead states
   m_states.emplace(StateName::Attacking, std::make_unique<Attacking>(*this));
@@ -46,8 +56,8 @@ StateMachine::StateMachine(Enemy &owner)
   // set current state to Patrolling
   m_current_state = m_states[StateName::Patrolling].get();
   // set init position to Patrolling start position
-  m_owner.set_bones_position(
-      static_cast<Patrolling *>(m_current_state)->get_start_position());
+  m_owner.set_bones_position(get_position_id(
+      static_cast<Patrolling *>(m_current_state)->get_start_position()));
 
   // there is no transitioning state at this moment
   m_transitioning_state = nullptr;
@@ -72,8 +82,8 @@ void StateMachine::reset() {
   // set current state to Patrolling
   m_current_state = m_states[StateName::Patrolling].get();
   // set init position to Patrolling start position
-  m_owner.set_bones_position(
-      static_cast<Patrolling *>(m_current_state)->get_start_position());
+  m_owner.set_bones_position(get_position_id(
+      static_cast<Patrolling *>(m_current_state)->get_start_position()));
 
   // there is no transitioning state at this moment
   m_transitioning_state = nullptr;
@@ -188,10 +198,10 @@ void StateMachine::create_transition_to_position_animation(
   if (position == Position::Attacking) {
     // if transitioning to attacking, ignore the spine bone because it is
     // controlled manually
-    m_owner.create_transition_animation(StateMachine::position_name(position),
+    m_owner.create_transition_animation(get_position_id(position),
                                         animatin_duration, Enemy::SPINE_BONE);
   } else {
-    m_owner.create_transition_animation(StateMachine::position_name(position),
+    m_owner.create_transition_animation(get_position_id(position),
                                         animatin_duration);
   }
   reset_transition_animation();
@@ -578,8 +588,11 @@ void Patrolling::execute(float delta_time) {
         auto [finished, global_transformation] =
             m_owner.get_animation(action_status.first).update(delta_time);
 
-        float delta_distance =
-            get_delta_distance_and_update_origin(global_transformation);
+        // root translation from the root motion baked at load
+        float delta_distance = get_delta_distance_and_update_origin(
+            m_owner.get_animation(action_status.first)
+                .root_motion()
+                .translation);
 
         if (finished) {
           // one cycle is finished, reset local origin
@@ -687,9 +700,9 @@ float Patrolling::get_orientation_angle_for_user_transformation(
 }
 
 float Patrolling::get_delta_distance_and_update_origin(
-    const glm::mat4 &global_transformation) {
+    const glm::vec3 &root_translation) {
   // enemy's origin in user transformation system = global_transformation *
-  // (0,0,0)
+  // (0,0,0) = root motion translation
 
   // previous time was i, current time is j
   // enemy's origin in user t. system:   (0,0,0)  |
@@ -697,7 +710,7 @@ float Patrolling::get_delta_distance_and_update_origin(
   // animation time:                        0     |                i | j
   //                                                         m_local_origin
   //                                                         new_local_origin
-  glm::vec3 new_local_origin = global_transformation * glm::vec4(0, 0, 0, 1);
+  const glm::vec3 &new_local_origin = root_translation;
 
   // in order to find how much enemy's position is changed, we need to take into
   // account user transformation scale
@@ -118,6 +118,9 @@ public:
   static const std::string &position_name(Position position);
 
 private:
+  // return handle of the position resolved in the constructor
+  PositionId get_position_id(Position position) const;
+
   AnimationController &get_animation(Action action);
   const AnimationController &get_animation(Action action) const;
 
@@ -139,6 +142,8 @@ private:
   static std::unordered_map<Position, std::string> s_positions;
 
   std::unordered_map<Action, AnimationController> m_action_to_animation;
+  // positions resolved from s_positions once
+  std::unordered_map<Position, PositionId> m_position_ids;
 
   std::unordered_map<StateName, std::unique_ptr<EnemyState>> m_states;
 
@@ -260,8 +265,7 @@ private:
 
   void rotate_user_transformation(float delta_time);
 
-  float
-  get_delta_distance_and_update_origin(const glm::mat4 &global_transformation);
+  float get_delta_distance_and_update_origin(const glm::vec3 &root_translation);
 
   Path m_path;
   glm::vec3 m_local_origin = glm::vec3(0, 0, 0);
@@ -51,6 +51,25 @@ void Game::update_frame_rate(float current_time) {
   }
 }
 
+std::string Game::get_stats() const {
+  std::string stats;
+#ifdef FPS_DEBUG
+  stats = "recomputed nodes: " +
+          std::to_string(m_level_manager.recomputed_nodes_count()) +
+          "  uniform queries: " +
+          std::to_string(m_level_manager.uniform_location_queries_count());
+
+  const RenderStats &render_stats = m_level_manager.render_stats();
+  stats += "  draw calls: " + std::to_string(render_stats.draw_calls) +
+           " (instanced: " + std::to_string(render_stats.instanced_draw_calls) +
+           ")  binds program/vao/texture: " +
+           std::to_string(render_stats.program_binds) + "/" +
+           std::to_string(render_stats.vao_binds) + "/" +
+           std::to_string(render_stats.texture_binds);
+#endif
+  return stats;
+}
+
 void Game::update(float current_time) {
   update_frame_rate(current_time);
 
@@ -62,7 +81,8 @@ void Game::update(float current_time) {
   }
 
   switch (m_menu.update({m_game_state, m_level_manager.player_lives(),
-                         m_level_manager.player_bullets(), m_frame_rate})) {
+                         m_level_manager.player_bullets(), m_frame_rate,
+                         get_stats()})) {
   case Menu::Result::Exit:
     m_exit = true;
     break;
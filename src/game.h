@@ -31,6 +31,8 @@ private:
   bool is_game_over() const;
 
   void update_frame_rate(float current_time);
+  // per frame counters shown in debug builds
+  std::string get_stats() const;
 
 private:
   unsigned int m_window_width;
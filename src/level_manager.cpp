@@ -7,6 +7,15 @@ const std::vector<glm::vec3> enemies_init_positions = {
 
 const glm::vec3 camera_init_position(6, 1.6, 15);
 
+namespace {
+const UniformHandle<unsigned int> OBJECT_INDEX_UNIFORM("gObjectIndex");
+} // namespace
+
+// enemies closer to the player than these distances are animated with the
+// given animation lod, farther enemies use quarter rate
+const float animation_lod_full_distance = 10.0f;
+const float animation_lod_half_distance = 25.0f;
+
 LevelManager::LevelManager(GLFWwindow *window, unsigned int window_width,
                            unsigned int window_height)
     : m_map(), m_collision_detector(),
@@ -192,43 +201,75 @@ void LevelManager::culling() {
   }
 }
 
-void LevelManager::render_player() {
+void LevelManager::update_animation_lods() {
+  // enemies that are not going to be rendered are not animated, their pose is
+  // evaluated only when it's queried
+  std::vector<bool> visible(m_enemies.size(), false);
+  for (unsigned int enemy_index : m_enemies_to_render) {
+    visible[enemy_index] = true;
+  }
+
+  for (unsigned int i = 0; i < m_enemies.size(); ++i) {
+    float distance =
+        glm::distance(m_enemies[i].get_position(), player_position());
+
+    if (!visible[i]) {
+      m_enemies[i].set_animation_lod(AnimationLod::Frozen);
+    } else if (distance < animation_lod_full_distance) {
+      m_enemies[i].set_animation_lod(AnimationLod::Full);
+    } else if (distance < animation_lod_half_distance) {
+      m_enemies[i].set_animation_lod(AnimationLod::Half);
+    } else {
+      m_enemies[i].set_animation_lod(AnimationLod::Quarter);
+    }
+  }
+}
+
+void LevelManager::submit_player() {
   if (!m_player.is_dead()) {
-    m_player.render(skinned_mesh_shader, bounding_box_shader, light);
+    m_player.submit(m_render_queue, skinned_mesh_shader, bounding_box_shader);
   }
 }
 
-void LevelManager::render_map() {
-  m_map.render(skinned_mesh_shader, bounding_box_shader, m_camera, light,
-               m_map_render_objects);
+void LevelManager::submit_map() {
+  m_map.submit(m_render_queue, skinned_mesh_shader, bounding_box_shader,
+               m_camera, m_map_render_objects);
 }
 
 void LevelManager::render_to_texture_map() {
   picking_shader.activate();
-  picking_shader.set_uniform<unsigned int>("gObjectIndex", 0);
+  picking_shader.set_uniform(OBJECT_INDEX_UNIFORM, 0u);
   m_map.render_to_texture(picking_shader, m_camera, m_map_render_objects);
 }
 
-void LevelManager::render_enemies() {
+void LevelManager::submit_enemies() {
   for (unsigned int enemy_index : m_enemies_to_render) {
-    m_enemies[enemy_index].render(skinned_mesh_shader,
+    m_enemies[enemy_index].submit(m_render_queue, skinned_mesh_shader,
                                   skinned_mesh_no_light_shader,
-                                  bounding_box_shader, m_camera, light);
+                                  bounding_box_shader, m_camera);
   }
 }
 
 void LevelManager::render_to_texture_enemies() {
   for (unsigned int enemy_index : m_enemies_to_render) {
+    // shots hit the pose at the current animation time, not the one left by
+    // the animation lod
+    m_enemies[enemy_index].evaluate_pose();
     picking_shader.activate();
-    picking_shader.set_uniform<unsigned int>("gObjectIndex", enemy_index + 1);
+    picking_shader.set_uniform(OBJECT_INDEX_UNIFORM, enemy_index + 1);
     m_enemies[enemy_index].render_to_texture(picking_shader, m_camera);
   }
 }
 
 void LevelManager::render() {
-  render_enemies();
-  render_player();
-  render_map();
+  submit_enemies();
+  submit_player();
+  submit_map();
+  m_render_queue.flush(m_camera, light);
+
+  if (!m_player.is_dead()) {
+    m_player.render_cursor();
+  }
 }
 
 void LevelManager::render_to_texture() {
@@ -282,6 +323,12 @@ void LevelManager::notify_enemies() {
 void LevelManager::update(float current_time) {
   // std::cout << m_player.camera().position()[0] << ","
   //           << m_player.camera().position()[2] << std::endl;
+  // counters include both update and rendering of the last frame
+  m_recomputed_nodes_count = SkinnedMesh::recomputed_nodes_count();
+  SkinnedMesh::reset_recomputed_nodes_count();
+  m_uniform_location_queries_count = Shader::uniform_location_queries_count();
+  Shader::reset_uniform_location_queries_count();
+
   update_active_rooms();
   update_collision_detector();
   m_player_controller.update(current_time);
@@ -295,10 +342,25 @@ void LevelManager::update(float current_time) {
   // always update cammera matrix before culling
   m_camera.update_matrix();
   culling();
+  // lods follow the visibility of this frame, they are used by the next
+  // updates
+  update_animation_lods();
 }
 
 void LevelManager::player_shot() { m_player.shot(); }
 
+unsigned int LevelManager::recomputed_nodes_count() const {
+  return m_recomputed_nodes_count;
+}
+
+unsigned int LevelManager::uniform_location_queries_count() const {
+  return m_uniform_location_queries_count;
+}
+
+const RenderStats &LevelManager::render_stats() const {
+  return m_render_queue.stats();
+}
+
 bool LevelManager::is_player_dead() const { return m_player.is_dead(); }
 
 Path LevelManager::find_enemy_path(unsigned int enemy_id) const {
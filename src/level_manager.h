@@ -9,6 +9,7 @@
 #include "nav_mesh.h"
 #include "player.h"
 #include "player_controller.h"
+#include "render_queue.h"
 #include "skinned_mesh.h"
 #include <algorithm>
 #include <iterator>
@@ -59,6 +60,14 @@ public:
 
   bool player_shoot_started() const;
 
+  // number of skinned mesh nodes recomputed in the last frame
+  unsigned int recomputed_nodes_count() const;
+  // number of uniform locations queried from the driver in the last frame,
+  // zero once all the shaders are linked
+  unsigned int uniform_location_queries_count() const;
+  // draw calls and program, vao and texture binds of the last rendered frame
+  const RenderStats &render_stats() const;
+
   short player_lives() const;
   short player_bullets() const;
 
@@ -71,9 +80,10 @@ private:
   // update collision detector with enemy and objects in active rooms
   void update_collision_detector();
 
-  void render_map();
-  void render_player();
-  void render_enemies();
+  // add draw items to the render queue
+  void submit_map();
+  void submit_player();
+  void submit_enemies();
   // render to texture is used to check if enemy is shot (3d mouse picking)
   void render_to_texture_map();
   void render_to_texture_enemies();
@@ -82,6 +92,10 @@ private:
   // cannot be seen
   void culling();
 
+  // set how often enemies poses are evaluated based on their visibility after
+  // culling and distance from the player
+  void update_animation_lods();
+
 public:
   const Map m_map;
   // map objects set during culling
@@ -104,6 +118,13 @@ public:
   std::vector<Enemy> m_enemies;
   // enemies that shoud be rendered
   std::vector<unsigned int> m_enemies_to_render;
+  // see recomputed_nodes_count
+  unsigned int m_recomputed_nodes_count = 0;
+  // see uniform_location_queries_count
+  unsigned int m_uniform_location_queries_count = 0;
+
+  // draw items of the frame, flushed at the end of render
+  RenderQueue m_render_queue;
 
   // objects used for rendering
   const Light light{glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
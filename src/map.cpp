@@ -14,6 +14,10 @@
 #include <utility>
 #include <vector>
 
+namespace {
+const UniformHandle<glm::mat4> TRANSFORMATION_UNIFORM("transformation");
+} // namespace
+
 Map::Map()
     : m_mesh{"../res/models/level1/level1.gltf"},
       m_room_nav_mesh_names{
@@ -43,12 +47,11 @@ const Map::Room *Map::get_room(const BVHNode<BoundingBox> *node) const {
   return room_it != m_rooms_index.end() ? &m_rooms[room_it->second] : nullptr;
 }
 
-void Map::render(Shader &shader, Shader &bounding_box_shader,
-                 const Camera &camera, const Light &light,
+void Map::submit(RenderQueue &queue, Shader &shader,
+                 Shader &bounding_box_shader, const Camera &camera,
                  const std::vector<unsigned int> &mesh_ids) const {
-  shader.activate();
-  shader.set_uniform("transformation", glm::mat4(1.0f));
-  m_mesh.render(shader, camera, light, mesh_ids, false /* exclude */);
+  m_mesh.submit(queue, RenderPass::Opaque, shader, camera, glm::mat4(1.0f),
+                mesh_ids, false /* exclude */);
 
 #ifdef FPS_DEBUG
   render_nav_meshes(bounding_box_shader, camera);
@@ -75,14 +78,14 @@ void Map::render_boxes(const BVHNode<BoundingBox> &node,
 void Map::render_to_texture(Shader &shader, const Camera &camera,
                             const std::vector<unsigned int> &mesh_ids) const {
   shader.activate();
-  shader.set_uniform("transformation", glm::mat4(1.0f));
+  shader.set_uniform(TRANSFORMATION_UNIFORM, glm::mat4(1.0f));
   m_mesh.render_to_texture(shader, camera, mesh_ids);
 }
 
 void Map::render_primitive(Shader &shader, const Camera &camera,
                            unsigned int entry, unsigned int primitive) const {
   shader.activate();
-  shader.set_uniform("transformation", glm::mat4(1.0f));
+  shader.set_uniform(TRANSFORMATION_UNIFORM, glm::mat4(1.0f));
   m_mesh.render_primitive(shader, camera, entry, primitive);
 }
 
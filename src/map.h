@@ -34,8 +34,9 @@ public:
 
   const Room *get_room(const BVHNode<BoundingBox> *node) const;
 
-  void render(Shader &shader, Shader &bounding_box_shader, const Camera &camera,
-              const Light &light,
+  // add draw items of the given objects to the queue
+  void submit(RenderQueue &queue, Shader &shader, Shader &bounding_box_shader,
+              const Camera &camera,
               const std::vector<unsigned int> &mesh_ids) const;
   void render_to_texture(Shader &shader, const Camera &camera,
                          const std::vector<unsigned int> &mesh_ids) const;
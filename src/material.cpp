@@ -1,8 +1,14 @@
 #include "material.h"
 #include "texture.h"
+#include <cstring>
 
 #include "utility.h"
 
+namespace {
+// uniform buffer binding point of the Material block
+const GLuint MATERIAL_BLOCK_BINDING = 0;
+} // namespace
+
 void Material::add(const Texture *texture) {
   if (texture && texture->type() == TextureType::DIFFUSE) {
     m_diffuse_tex.push_back(texture);
@@ -27,30 +33,87 @@ glm::mat3 Material::get_uv_transformation(const Texture *texture) const {
              : glm::mat3(1.0f);
 }
 
-void Material::set_slots(Shader &shader, const std::string &uniform) const {
-  for (int i = 0; i < m_diffuse_tex.size(); ++i) {
-    // sampler2D uniform needs to be set as integer, not unsigned int
-    shader.set_uniform<int>(uniform + std::to_string(i),
-                            m_diffuse_tex[i]->slot());
+MaterialBlock Material::get_block() const {
+  MaterialBlock block;
+  for (unsigned int unit = 0; unit < MAX_DIFFUSE_TEXTURES; ++unit) {
+    glm::mat3 uv_transformation =
+        unit < m_diffuse_tex.size() ? get_uv_transformation(m_diffuse_tex[unit])
+                                    : glm::mat3(1.0f);
+    for (int i = 0; i < 3; ++i) {
+      block.uv_transformation[unit][i] = glm::vec4(uv_transformation[i], 0.0f);
+    }
   }
+  return block;
 }
 
-void Material::set_uv_transformations(Shader &shader,
-                                      const std::string &uniform) const {
-  for (int i = 0; i < m_diffuse_tex.size(); ++i) {
-    shader.set_uniform(uniform + std::to_string(i),
-                       get_uv_transformation(m_diffuse_tex[i]));
+unsigned int MaterialBuffer::next_material_id = 0;
+
+MaterialBuffer::MaterialBuffer(const std::vector<Material> &materials)
+    : m_id(0), m_stride(0), m_first_material_id(next_material_id) {
+  next_material_id += materials.size();
+  if (materials.empty()) {
+    return;
   }
+
+  // every block has to start at an offset aligned for glBindBufferRange
+  GLint alignment = 1;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  m_stride = (sizeof(MaterialBlock) + alignment - 1) / alignment * alignment;
+
+  std::vector<unsigned char> data(m_stride * materials.size());
+  for (unsigned int i = 0; i < materials.size(); ++i) {
+    MaterialBlock block = materials[i].get_block();
+    std::memcpy(&data[i * m_stride], &block, sizeof(MaterialBlock));
+  }
+
+  // materials don't change after loading
+  glCreateBuffers(1, &m_id);
+  glNamedBufferStorage(m_id, data.size(), data.data(), 0);
 }
 
-void Material::bind() const {
-  for (const auto &texture : m_diffuse_tex) {
-    texture->bind();
+MaterialBuffer::~MaterialBuffer() {
+  if (m_id != 0) {
+    glDeleteBuffers(1, &m_id);
   }
 }
 
-void Material::unbind() const {
-  for (const auto &texture : m_diffuse_tex) {
-    texture->unbind();
+void MaterialBuffer::bind(unsigned int material_index) const {
+  glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_id,
+                    material_index * m_stride, sizeof(MaterialBlock));
+}
+
+void MaterialState::bind(const MaterialBuffer &material_buffer,
+                         unsigned int material_index,
+                         const Material &material) {
+  if (m_material_buffer == &material_buffer &&
+      m_material_index == material_index) {
+    return;
   }
+
+  material_buffer.bind(material_index);
+  m_material_buffer = &material_buffer;
+  m_material_index = material_index;
+
+  // materials often share textures, only changed units are rebound
+  const auto &textures = material.diffuse_textures();
+  for (unsigned int unit = 0; unit < MAX_DIFFUSE_TEXTURES; ++unit) {
+    const Texture *texture = unit < textures.size() ? textures[unit] : nullptr;
+    if (m_textures[unit] && *m_textures[unit] == texture) {
+      continue;
+    }
+
+    if (texture) {
+      texture->bind(unit);
+    } else {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    m_textures[unit] = texture;
+    ++m_texture_binds;
+  }
+}
+
+void MaterialState::reset() {
+  m_material_buffer = nullptr;
+  m_textures.fill(std::nullopt);
 }
@@ -3,9 +3,22 @@
 
 #include "shader.h"
 #include "texture.h"
+#include <array>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
+// maximum number of diffuse textures of a material bound for the shaders,
+// diffuse texture i is bound to texture unit i
+const unsigned int MAX_DIFFUSE_TEXTURES = 4;
+
+// material data laid out as the Material uniform block (std140)
+struct MaterialBlock {
+  // uv transformation of the diffuse texture of each texture unit, mat3
+  // columns are padded to vec4
+  glm::vec4 uv_transformation[MAX_DIFFUSE_TEXTURES][3];
+};
+
 struct UVTransform {
   glm::mat3 translation = glm::mat4(1.0f);
   glm::mat3 rotation = glm::mat4(1.0f);
@@ -21,11 +34,12 @@ public:
   void add(const Texture *texture);
   void add(const Texture *texture, UVTransform uv_transform);
 
-  void set_slots(Shader &shader, const std::string &uniform) const;
-  void set_uv_transformations(Shader &shader, const std::string &uniform) const;
+  const std::vector<const Texture *> &diffuse_textures() const {
+    return m_diffuse_tex;
+  }
 
-  void bind() const;
-  void unbind() const;
+  // return material data for the material uniform buffer
+  MaterialBlock get_block() const;
 
 private:
   glm::mat3 get_uv_transformation(const Texture *texture) const;
@@ -34,4 +48,56 @@ private:
   std::unordered_map<const Texture *, UVTransform> m_uv_transform_map;
 };
 
+// uniform buffer with blocks of all the materials of a mesh created at load,
+// a material is bound as a range of the buffer
+class MaterialBuffer {
+public:
+  MaterialBuffer(const std::vector<Material> &materials);
+  ~MaterialBuffer();
+
+  MaterialBuffer(const MaterialBuffer &) = delete;
+  MaterialBuffer &operator=(const MaterialBuffer &) = delete;
+
+  void bind(unsigned int material_index) const;
+
+  // id of the material unique among the materials of all the buffers, used to
+  // sort draw calls by material
+  unsigned int material_id(unsigned int material_index) const {
+    return m_first_material_id + material_index;
+  }
+
+private:
+  GLuint m_id;
+  // distance between two material blocks in bytes
+  GLintptr m_stride;
+  // id of the first material of the buffer
+  unsigned int m_first_material_id;
+
+  // id of the first material of the next created buffer
+  static unsigned int next_material_id;
+};
+
+// material bound by the last draw call, binding the same material or the same
+// textures again is skipped
+// state is valid only while nothing else changes the bindings, so it's reset
+// before every batch of draw calls
+class MaterialState {
+public:
+  void bind(const MaterialBuffer &material_buffer, unsigned int material_index,
+            const Material &material);
+  // forget what is bound, the next bind binds everything
+  void reset();
+
+  // number of textures bound through this state since it was created
+  unsigned int texture_binds() const { return m_texture_binds; }
+
+private:
+  const MaterialBuffer *m_material_buffer = nullptr;
+  unsigned int m_material_index = 0;
+  // texture unit -> bound texture (nullptr if unit is empty, nullopt if
+  // unknown)
+  std::array<std::optional<const Texture *>, MAX_DIFFUSE_TEXTURES> m_textures;
+  unsigned int m_texture_binds = 0;
+};
+
 #endif /* _MATERIAL_H_ */
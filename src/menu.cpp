@@ -58,6 +58,11 @@ void Menu::draw_text() const {
        "  bullets: " + std::to_string(m_state.bullets) +
        "  frame rate: " + std::to_string(m_state.frame_rate))
           .c_str());
+  if (!m_state.stats.empty()) {
+    ImGui::GetForegroundDrawList()->AddText(
+        ImVec2(0, ImGui::GetFontSize()),
+        ImGui::ColorConvertFloat4ToU32({1, 1, 1, 1}), m_state.stats.c_str());
+  }
 }
 
 Menu::Result Menu::update(State state) {
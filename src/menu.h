@@ -7,6 +7,7 @@
 #include <imgui_internal.h>
 
 #include <iostream>
+#include <string>
 
 class Menu {
 public:
@@ -18,6 +19,8 @@ public:
     short lives;
     short bullets;
     short frame_rate;
+    // debug statistics shown under the game info (empty if not shown)
+    std::string stats;
   };
 
   Menu(GLFWwindow *window, unsigned int window_width,
@@ -9,6 +9,11 @@
 
 #define EPS 0.0001
 
+namespace {
+const UniformHandle<glm::vec3> COLOR_UNIFORM("Color");
+const UniformHandle<glm::mat4> CAM_MATRIX_UNIFORM("camMatrix");
+} // namespace
+
 // ------------------- Bezier -------------------------------------------
 Bezier::Bezier(glm::vec3 p1, glm::vec3 p2)
     : m_points({std::move(p1), std::move(p2)}),
@@ -253,9 +258,9 @@ void NavMesh::render(Shader &shader, const Camera &camera) const {
 
   shader.activate();
 
-  glUniform3f(glGetUniformLocation(shader.id(), "Color"), 0, 1, 0);
+  shader.set_uniform(COLOR_UNIFORM, glm::vec3(0, 1, 0));
 
-  shader.set_uniform("camMatrix", camera.matrix());
+  shader.set_uniform(CAM_MATRIX_UNIFORM, camera.matrix());
   glDrawElements(GL_LINES, indices.size(), GL_UNSIGNED_INT, 0);
 
   // unbind
@@ -40,13 +40,9 @@ void Player::reset() {
   set_user_translation();
 }
 
-void Player::render(Shader &shader, Shader &bounding_box_shader,
-                    const Light &light) {
-  AnimatedMesh::render(shader, m_camera, light);
-
-  if (m_todo_action == Action::None) {
-    m_cursor.render();
-  }
+void Player::submit(RenderQueue &queue, Shader &shader,
+                    Shader &bounding_box_shader) {
+  AnimatedMesh::submit(queue, RenderPass::Opaque, shader, m_camera);
 
 #ifdef FPS_DEBUG
   // for testing only
@@ -54,6 +50,12 @@ void Player::render(Shader &shader, Shader &bounding_box_shader,
 #endif
 }
 
+void Player::render_cursor() {
+  if (m_todo_action == Action::None) {
+    m_cursor.render();
+  }
+}
+
 void Player::set_orientation(glm::vec3 orientation) {
   m_camera.orientation() = std::move(orientation);
   // when updating camera orientation both player rotation and translation
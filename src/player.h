@@ -24,7 +24,10 @@ public:
 
   void reset();
 
-  void render(Shader &shader, Shader &bounding_box_shader, const Light &light);
+  // add draw items to the queue
+  void submit(RenderQueue &queue, Shader &shader, Shader &bounding_box_shader);
+  // cursor is drawn over the scene, after the queue is flushed
+  void render_cursor();
 
   void set_user_scaling();
   void set_user_rotation();
@@ -0,0 +1,174 @@
+// benchmark of the pose evaluation of a whole skeleton
+// compares the matrix products the hierarchy used before (three mat4s per
+// local transformation and full mat4 products) with compose_transformation
+// and the concatenate_pose kernel, and checks both give the same palette
+#include "utility.h"
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <chrono>
+#include <glm/gtx/transform.hpp>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+const unsigned int ITERATIONS = 100000;
+// maximum difference of a palette column relative to its length
+const float TOLERANCE = 1e-4f;
+
+struct Node {
+  glm::vec3 translation;
+  glm::quat rotation;
+  glm::vec3 scaling;
+
+  glm::mat4 local_transformation = glm::mat4(1.0f);
+  glm::mat4 global_transformation = glm::mat4(1.0f);
+};
+
+struct Bone {
+  glm::mat4 offset;
+};
+
+// skeleton flattened in depth-first order like SkinnedMesh's transformation
+// tree
+struct Skeleton {
+  std::vector<Node> nodes;
+  std::vector<int> parents;
+  std::vector<int> node_bones;
+  std::vector<Bone> bones;
+};
+
+void add_nodes(const aiNode *node, int parent_index,
+               const std::unordered_map<std::string, int> &bone_index,
+               Skeleton &skeleton) {
+  aiVector3D scaling;
+  aiQuaternion rotation;
+  aiVector3D translation;
+  node->mTransformation.Decompose(scaling, rotation, translation);
+
+  Node skeleton_node;
+  skeleton_node.translation = utility::convert_to_glm_vec3(translation);
+  skeleton_node.rotation =
+      glm::normalize(utility::convert_to_glm_quat(rotation));
+  skeleton_node.scaling = utility::convert_to_glm_vec3(scaling);
+
+  int index = skeleton.nodes.size();
+  skeleton.nodes.push_back(skeleton_node);
+  skeleton.parents.push_back(parent_index);
+  auto bone_it = bone_index.find(node->mName.data);
+  skeleton.node_bones.push_back(bone_it != bone_index.end() ? bone_it->second
+                                                            : -1);
+
+  for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+    add_nodes(node->mChildren[i], index, bone_index, skeleton);
+  }
+}
+
+Skeleton load_skeleton(const aiScene *scene) {
+  Skeleton skeleton;
+  std::unordered_map<std::string, int> bone_index;
+  for (unsigned int m = 0; m < scene->mNumMeshes; ++m) {
+    const aiMesh *mesh = scene->mMeshes[m];
+    for (unsigned int b = 0; b < mesh->mNumBones; ++b) {
+      const aiBone *bone = mesh->mBones[b];
+      if (bone_index.emplace(bone->mName.data, skeleton.bones.size()).second) {
+        skeleton.bones.push_back(
+            {utility::convert_to_glm_mat4(bone->mOffsetMatrix)});
+      }
+    }
+  }
+
+  add_nodes(scene->mRootNode, -1, bone_index, skeleton);
+  return skeleton;
+}
+
+// pose evaluation before the kernel
+void evaluate_before(Skeleton &skeleton, std::vector<glm::mat4> &palette) {
+  auto &nodes = skeleton.nodes;
+  for (unsigned int i = 0; i < nodes.size(); ++i) {
+    auto &node = nodes[i];
+    node.local_transformation =
+        glm::translate(glm::mat4(1.0f), node.translation) *
+        glm::toMat4(node.rotation) * glm::scale(glm::mat4(1.0f), node.scaling);
+    node.global_transformation =
+        skeleton.parents[i] < 0
+            ? glm::mat4(1.0f)
+            : nodes[skeleton.parents[i]].global_transformation *
+                  node.local_transformation;
+
+    int bone_index = skeleton.node_bones[i];
+    if (bone_index >= 0) {
+      palette[bone_index] =
+          node.global_transformation * skeleton.bones[bone_index].offset;
+    }
+  }
+}
+
+void evaluate_after(Skeleton &skeleton, std::vector<glm::mat3x4> &palette) {
+  for (auto &node : skeleton.nodes) {
+    node.local_transformation = utility::compose_transformation(
+        node.translation, node.rotation, node.scaling);
+  }
+  utility::concatenate_pose(skeleton.nodes, skeleton.parents,
+                            skeleton.node_bones, skeleton.bones, palette, 0,
+                            skeleton.nodes.size());
+}
+
+// run evaluate ITERATIONS times, return nanoseconds per skeleton
+template <typename Evaluate> double measure(Evaluate evaluate) {
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < ITERATIONS; ++i) {
+    evaluate();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         ITERATIONS;
+}
+
+// return the largest difference between the two palettes relative to the
+// length of the expected column
+float get_palette_error(const std::vector<glm::mat4> &expected,
+                        const std::vector<glm::mat3x4> &palette) {
+  float error = 0.0f;
+  for (unsigned int b = 0; b < expected.size(); ++b) {
+    glm::mat4 transformation = utility::get_affine_matrix(palette[b]);
+    for (int i = 0; i < 4; ++i) {
+      error = std::max(error, glm::length(transformation[i] - expected[b][i]) /
+                                  (1.0f + glm::length(expected[b][i])));
+    }
+  }
+  return error;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string filename = argc > 1 ? argv[1] : "../res/models/enemy/enemy.gltf";
+
+  Assimp::Importer importer;
+  const aiScene *scene = importer.ReadFile(filename.c_str(), 0);
+  if (!scene || !scene->mRootNode) {
+    std::cout << "Error parsing '" << filename
+              << "': " << importer.GetErrorString() << std::endl;
+    return 1;
+  }
+
+  Skeleton skeleton = load_skeleton(scene);
+  std::vector<glm::mat4> palette_before(skeleton.bones.size());
+  std::vector<glm::mat3x4> palette_after(skeleton.bones.size());
+
+  double before_time =
+      measure([&]() { evaluate_before(skeleton, palette_before); });
+  double after_time =
+      measure([&]() { evaluate_after(skeleton, palette_after); });
+  float error = get_palette_error(palette_before, palette_after);
+
+  std::cout << filename << ": " << skeleton.nodes.size() << " nodes, "
+            << skeleton.bones.size() << " bones" << std::endl;
+  std::cout << "before " << before_time << " ns, after " << after_time
+            << " ns per skeleton, speedup " << before_time / after_time
+            << std::endl;
+  std::cout << "largest palette error " << error << std::endl;
+  return error <= TOLERANCE ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include "pose_cache.h"
+#include "animation.h"
+#include <cassert>
+#include <cmath>
+
+std::size_t BakedAnimation::get_memory_size() const {
+  return node_transformations.size() * sizeof(glm::mat4) +
+         bone_transformations.size() * sizeof(glm::mat3x4);
+}
+
+std::size_t BakedAnimation::get_memory_size(unsigned int frame_count,
+                                            unsigned int nodes_count,
+                                            unsigned int bones_count) {
+  return frame_count * (nodes_count * sizeof(glm::mat4) +
+                        bones_count * sizeof(glm::mat3x4));
+}
+
+std::size_t PoseCache::KeyHash::operator()(const Key &key) const {
+  std::size_t seed = std::hash<const Animation *>()(key.animation);
+  return seed ^ (key.base_pose + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+PoseCache::PoseCache(float sample_rate, std::size_t memory_limit)
+    : m_sample_rate(sample_rate), m_memory_limit(memory_limit),
+      m_memory_size(0) {}
+
+unsigned int PoseCache::get_frame_count(const Animation &animation) const {
+  // frames are evenly spaced and the last one is exactly at the end of the
+  // animation
+  return animation.m_duration > 0.0f
+             ? static_cast<unsigned int>(
+                   std::ceil(animation.m_duration * m_sample_rate /
+                             animation.m_ticks_per_second)) +
+                   1
+             : 1;
+}
+
+std::shared_ptr<const BakedAnimation>
+PoseCache::get(const Key &key, std::size_t memory_size,
+               const std::function<BakedAnimation()> &bake) {
+  if (memory_size > m_memory_limit) {
+    // animation is evaluated instead, it isn't baked at all, so switching
+    // to it again doesn't bake it again
+    return nullptr;
+  }
+
+  auto entry_it = m_entries_index.find(key);
+  if (entry_it != m_entries_index.end()) {
+    // move to the front as the most recently used
+    m_entries.splice(m_entries.begin(), m_entries, entry_it->second);
+    return entry_it->second->second;
+  }
+
+  auto baked_animation = std::make_shared<const BakedAnimation>(bake());
+  assert(baked_animation->get_memory_size() == memory_size &&
+         "baked animation size matches the estimate");
+  m_memory_size += memory_size;
+  m_entries.emplace_front(key, baked_animation);
+  m_entries_index[key] = m_entries.begin();
+  evict();
+
+  return baked_animation;
+}
+
+void PoseCache::evict() {
+  // remove the least recently used animations, instances that still use
+  // them keep them alive until they stop
+  while (m_memory_size > m_memory_limit && !m_entries.empty()) {
+    m_memory_size -= m_entries.back().second->get_memory_size();
+    m_entries_index.erase(m_entries.back().first);
+    m_entries.pop_back();
+  }
+}
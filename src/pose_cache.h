@@ -0,0 +1,88 @@
+#ifndef _POSE_CACHE_H_
+#define _POSE_CACHE_H_
+
+#include <cstddef>
+#include <functional>
+#include <glm/fwd.hpp>
+#include <glm/mat3x4.hpp>
+#include <glm/mat4x4.hpp>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Animation;
+
+// nodes global transformations and bones final transformations of an
+// animation evaluated at evenly spaced frames
+struct BakedAnimation {
+  unsigned int frame_count = 0;
+  // time between two frames in ticks
+  float frame_duration = 0.0f;
+  // frame f, node n -> f * nodes count + n
+  std::vector<glm::mat4> node_transformations;
+  // frame f, bone b -> f * bones count + b
+  std::vector<glm::mat3x4> bone_transformations;
+
+  // return size in bytes
+  std::size_t get_memory_size() const;
+  // return size in bytes of an animation baked into the given number of
+  // frames
+  static std::size_t get_memory_size(unsigned int frame_count,
+                                     unsigned int nodes_count,
+                                     unsigned int bones_count);
+};
+
+// baked animations shared by all the copies of a skinned mesh
+// nodes that are not animated by an animation keep the transformations from
+// before the animation started, so the same animation is baked once for
+// each such base pose
+// animation is baked lazily when it is requested for the first time for a
+// base pose and the least recently used animations are removed when the
+// memory limit is reached
+class PoseCache {
+public:
+  struct Key {
+    const Animation *animation;
+    // hash of the transformations of the nodes not animated by the animation
+    std::size_t base_pose;
+
+    bool operator==(const Key &other) const {
+      return animation == other.animation && base_pose == other.base_pose;
+    }
+  };
+
+  PoseCache(float sample_rate, std::size_t memory_limit);
+
+  // return number of frames the animation is baked into
+  unsigned int get_frame_count(const Animation &animation) const;
+
+  // return baked animation for the given key, bake it by calling bake
+  // function if it's not baked yet
+  // memory size is the size of the baked animation, animation that doesn't
+  // fit into the memory limit is never baked and nullptr is returned
+  std::shared_ptr<const BakedAnimation>
+  get(const Key &key, std::size_t memory_size,
+      const std::function<BakedAnimation()> &bake);
+
+private:
+  struct KeyHash {
+    std::size_t operator()(const Key &key) const;
+  };
+
+  using Entry = std::pair<Key, std::shared_ptr<const BakedAnimation>>;
+
+  void evict();
+
+  // frames per second
+  float m_sample_rate;
+  // maximum size of all the baked animations in bytes
+  std::size_t m_memory_limit;
+  std::size_t m_memory_size;
+
+  // baked animations, the most recently used is the first
+  std::list<Entry> m_entries;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_entries_index;
+};
+
+#endif /* _POSE_CACHE_H_ */
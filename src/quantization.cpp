@@ -0,0 +1,118 @@
+#include "quantization.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// components other than the largest one are in [-1/sqrt(2), 1/sqrt(2)]
+const float SMALLEST_THREE_RANGE = 0.70710678f;
+const std::uint64_t COMPONENT_MASK = (1u << 15) - 1;
+const std::uint16_t VECTOR_COMPONENT_MAX = 65535;
+
+std::uint64_t quantize_component(float c) {
+  float normalized = std::clamp(
+      (c / SMALLEST_THREE_RANGE) * 0.5f + 0.5f, 0.0f, 1.0f);
+  return static_cast<std::uint64_t>(std::round(normalized * COMPONENT_MASK));
+}
+
+float dequantize_component(std::uint64_t c) {
+  float normalized = static_cast<float>(c) / COMPONENT_MASK;
+  return (normalized * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+}
+} // namespace
+
+namespace quantization {
+QuantizedQuat quantize(const glm::quat &q) {
+  unsigned int largest = 0;
+  for (unsigned int i = 1; i < 4; ++i) {
+    if (std::abs(q[i]) > std::abs(q[largest])) {
+      largest = i;
+    }
+  }
+
+  // q and -q represent the same rotation, so the dropped component can
+  // always be positive
+  float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+  std::uint64_t packed = largest;
+  for (unsigned int i = 0; i < 4; ++i) {
+    if (i != largest) {
+      packed = (packed << 15) | quantize_component(sign * q[i]);
+    }
+  }
+
+  return {static_cast<std::uint16_t>(packed >> 32),
+          static_cast<std::uint16_t>(packed >> 16),
+          static_cast<std::uint16_t>(packed)};
+}
+
+glm::quat dequantize(const QuantizedQuat &q) {
+  std::uint64_t packed = (static_cast<std::uint64_t>(q.data[0]) << 32) |
+                         (static_cast<std::uint64_t>(q.data[1]) << 16) |
+                         static_cast<std::uint64_t>(q.data[2]);
+  unsigned int largest = static_cast<unsigned int>(packed >> 45);
+
+  glm::quat result;
+  float sum = 0.0f;
+  int shift = 30;
+  for (unsigned int i = 0; i < 4; ++i) {
+    if (i != largest) {
+      result[i] = dequantize_component((packed >> shift) & COMPONENT_MASK);
+      sum += result[i] * result[i];
+      shift -= 15;
+    }
+  }
+  result[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+
+  return result;
+}
+
+QuantizationRange get_range(const std::vector<glm::vec3> &vectors) {
+  QuantizationRange range;
+  if (vectors.empty()) {
+    return range;
+  }
+
+  glm::vec3 max = vectors[0];
+  range.min = vectors[0];
+  for (const auto &v : vectors) {
+    range.min = glm::min(range.min, v);
+    max = glm::max(max, v);
+  }
+  range.extent = max - range.min;
+
+  return range;
+}
+
+QuantizedVec3 quantize(const glm::vec3 &v, const QuantizationRange &range) {
+  QuantizedVec3 result;
+  for (unsigned int i = 0; i < 3; ++i) {
+    float normalized =
+        range.extent[i] > 0.0f
+            ? std::clamp((v[i] - range.min[i]) / range.extent[i], 0.0f, 1.0f)
+            : 0.0f;
+    result.data[i] = static_cast<std::uint16_t>(
+        std::round(normalized * VECTOR_COMPONENT_MAX));
+  }
+  return result;
+}
+
+glm::vec3 dequantize(const QuantizedVec3 &v, const QuantizationRange &range) {
+  glm::vec3 result;
+  for (unsigned int i = 0; i < 3; ++i) {
+    result[i] = range.min[i] + range.extent[i] *
+                                   static_cast<float>(v.data[i]) /
+                                   VECTOR_COMPONENT_MAX;
+  }
+  return result;
+}
+
+float get_rotation_error(const glm::quat &q1, const glm::quat &q2) {
+  float d = std::min(std::abs(glm::dot(q1, q2)), 1.0f);
+  return 2.0f * std::acos(d);
+}
+
+float get_vector_error(const glm::vec3 &v1, const glm::vec3 &v2) {
+  glm::vec3 d = glm::abs(v1 - v2);
+  return std::max(d.x, std::max(d.y, d.z));
+}
+}; // namespace quantization
@@ -0,0 +1,42 @@
+#ifndef _QUANTIZATION_H_
+#define _QUANTIZATION_H_
+
+#include <cstdint>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/fwd.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+// unit quaternion stored in 48 bits using smallest three encoding
+// the largest component is dropped and the other three are stored in 15 bits
+// each, the remaining 2 bits hold the index of the dropped component
+struct QuantizedQuat {
+  std::uint16_t data[3];
+};
+
+// vector stored as 16 bits per component relative to a range
+struct QuantizedVec3 {
+  std::uint16_t data[3];
+};
+
+// range of the quantized vectors
+struct QuantizationRange {
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 extent = glm::vec3(0.0f);
+};
+
+namespace quantization {
+QuantizedQuat quantize(const glm::quat &q);
+glm::quat dequantize(const QuantizedQuat &q);
+
+QuantizationRange get_range(const std::vector<glm::vec3> &vectors);
+QuantizedVec3 quantize(const glm::vec3 &v, const QuantizationRange &range);
+glm::vec3 dequantize(const QuantizedVec3 &v, const QuantizationRange &range);
+
+// return angle in radians between the two rotations
+float get_rotation_error(const glm::quat &q1, const glm::quat &q2);
+// return the largest absolute difference of the vectors components
+float get_vector_error(const glm::vec3 &v1, const glm::vec3 &v2);
+}; // namespace quantization
+
+#endif /* _QUANTIZATION_H_ */
@@ -0,0 +1,258 @@
+#include "render_queue.h"
+#include "skinned_mesh.h"
+#include "utility.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+// bits of the sort key fields, from the highest to the lowest
+const unsigned int PASS_BITS = 4;
+const unsigned int SHADER_BITS = 8;
+const unsigned int MATERIAL_BITS = 16;
+const unsigned int VAO_BITS = 20;
+const unsigned int DEPTH_BITS = 16;
+// distances from the camera are quantized in [0, MAX_SORT_DEPTH], farther
+// objects share the last value
+const float MAX_SORT_DEPTH = 128.0f;
+// current instance before any instance uniforms are set
+const unsigned int NO_INSTANCE = std::numeric_limits<unsigned int>::max();
+// shader storage binding points, palettes use the same bindings as the
+// palettes of one skinned mesh copy
+const GLuint BONE_MATRICES_BINDING = 0;
+const GLuint BONE_DUAL_QUATERNIONS_BINDING = 1;
+const GLuint INSTANCE_DATA_BINDING = 2;
+
+const UniformHandle<glm::vec3> CAM_POS_UNIFORM("camPos");
+const UniformHandle<glm::mat4> CAM_MATRIX_UNIFORM("camMatrix");
+const UniformHandle<glm::vec3> LIGHT_POS_UNIFORM("lightPos");
+const UniformHandle<glm::vec4> LIGHT_COLOR_UNIFORM("lightColor");
+const UniformHandle<glm::mat4> TRANSFORMATION_UNIFORM("transformation");
+const UniformHandle<int> INSTANCED_UNIFORM("gInstanced");
+const UniformHandle<int> INSTANCE_BASE_UNIFORM("gInstanceBase");
+const UniformHandle<int> USE_DUAL_QUATERNIONS_UNIFORM("gUseDualQuaternions");
+
+// return value truncated to the given number of bits
+std::uint64_t key_field(std::uint64_t value, unsigned int bits) {
+  return value & ((std::uint64_t(1) << bits) - 1);
+}
+
+std::uint64_t key_pass(std::uint64_t key) { return key >> (64 - PASS_BITS); }
+} // namespace
+
+std::uint64_t RenderQueue::make_key(RenderPass pass, const Shader &shader,
+                                    unsigned int material_id, GLuint vao,
+                                    float depth) {
+  static_assert(PASS_BITS + SHADER_BITS + MATERIAL_BITS + VAO_BITS +
+                        DEPTH_BITS ==
+                    64,
+                "sort key fields fill 64 bits");
+
+  float normalized_depth = std::clamp(depth / MAX_SORT_DEPTH, 0.0f, 1.0f);
+  std::uint64_t quantized_depth = static_cast<std::uint64_t>(
+      normalized_depth * ((std::uint64_t(1) << DEPTH_BITS) - 1));
+
+  // truncated fields only make sorting less effective, draw items still keep
+  // their full state
+  std::uint64_t key = key_field(static_cast<std::uint64_t>(pass), PASS_BITS);
+  key = (key << SHADER_BITS) | key_field(shader.id(), SHADER_BITS);
+  key = (key << MATERIAL_BITS) | key_field(material_id, MATERIAL_BITS);
+  key = (key << VAO_BITS) | key_field(vao, VAO_BITS);
+  key = (key << DEPTH_BITS) | quantized_depth;
+  return key;
+}
+
+unsigned int RenderQueue::add_instance(const SkinnedMesh &mesh,
+                                       const glm::mat4 &transformation) {
+  m_instances.push_back({&mesh, transformation});
+  return m_instances.size() - 1;
+}
+
+void RenderQueue::submit(const DrawItem &item) {
+  assert(item.instance < m_instances.size() && "instance added");
+  m_items.push_back(item);
+}
+
+void RenderQueue::flush(const Camera &camera, const Light &light) {
+  std::sort(m_items.begin(), m_items.end(),
+            [](const DrawItem &lhs, const DrawItem &rhs) {
+              return lhs.key < rhs.key;
+            });
+  prepare_batches();
+
+  m_stats = RenderStats();
+  unsigned int texture_binds = m_material_state.texture_binds();
+  // bindings could have been changed since the last flush
+  m_material_state.reset();
+
+  const Shader *current_shader = nullptr;
+  GLuint current_vao = 0;
+  unsigned int current_instance = NO_INSTANCE;
+  auto batch_it = m_batches.begin();
+  for (unsigned int i = 0; i < m_items.size();) {
+    const auto &item = m_items[i];
+    if (item.shader != current_shader) {
+      item.shader->activate();
+      ++m_stats.program_binds;
+      // set camera position and matrix
+      item.shader->set_uniform(CAM_POS_UNIFORM, camera.position());
+      item.shader->set_uniform(CAM_MATRIX_UNIFORM, camera.matrix());
+      // set light position and color
+      item.shader->set_uniform(LIGHT_POS_UNIFORM, light.position());
+      item.shader->set_uniform(LIGHT_COLOR_UNIFORM, light.color());
+      current_shader = item.shader;
+      // instance uniforms belong to the previous program
+      current_instance = NO_INSTANCE;
+    }
+
+    if (item.vao != current_vao) {
+      glBindVertexArray(item.vao);
+      ++m_stats.vao_binds;
+      current_vao = item.vao;
+    }
+
+    if (batch_it != m_batches.end() && batch_it->begin == i) {
+      draw_batch(*batch_it);
+      // instanced draw call changed instance uniforms and palettes bindings
+      current_instance = NO_INSTANCE;
+      i = batch_it->end;
+      ++batch_it;
+      continue;
+    }
+
+    const Instance &instance = m_instances[item.instance];
+    if (item.instance != current_instance) {
+      item.shader->set_uniform(INSTANCED_UNIFORM, 0);
+      item.shader->set_uniform(TRANSFORMATION_UNIFORM,
+                               instance.transformation);
+      instance.mesh->bind_instance(*item.shader);
+      current_instance = item.instance;
+    }
+
+    instance.mesh->draw_mesh(*item.shader, item.mesh_id, *item.transformation,
+                             m_material_state);
+    ++m_stats.draw_calls;
+    ++i;
+  }
+
+  // unbind
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  m_stats.texture_binds = m_material_state.texture_binds() - texture_binds;
+  m_items.clear();
+  m_instances.clear();
+  m_batches.clear();
+  m_instance_data.clear();
+  m_bone_matrices.clear();
+  m_bone_dual_quaternions.clear();
+}
+
+bool RenderQueue::can_instance(const DrawItem &lhs,
+                               const DrawItem &rhs) const {
+  // palettes of one draw call have to be of the same kind
+  return key_pass(lhs.key) == key_pass(rhs.key) && lhs.shader == rhs.shader &&
+         lhs.vao == rhs.vao && lhs.mesh_id == rhs.mesh_id &&
+         lhs.instance != rhs.instance &&
+         m_instances[lhs.instance].mesh->skinning_mode() ==
+             m_instances[rhs.instance].mesh->skinning_mode() &&
+         lhs.shader->has_uniform(INSTANCED_UNIFORM) &&
+         lhs.shader->has_uniform(USE_DUAL_QUATERNIONS_UNIFORM);
+}
+
+void RenderQueue::prepare_batches() {
+  // items are sorted, so the same mesh entry of different copies forms a run
+  for (unsigned int begin = 0; begin < m_items.size();) {
+    unsigned int end = begin + 1;
+    while (end < m_items.size() && can_instance(m_items[begin], m_items[end])) {
+      ++end;
+    }
+
+    if (end - begin > 1) {
+      m_batches.push_back(
+          {begin, end, static_cast<unsigned int>(m_instance_data.size())});
+      for (unsigned int i = begin; i < end; ++i) {
+        const auto &item = m_items[i];
+        Instance &instance = m_instances[item.instance];
+        InstanceData data{};
+        data.transformation =
+            instance.transformation *
+            instance.mesh->get_model_transformation(item.mesh_id,
+                                                    *item.transformation);
+        data.bone_offset = add_palette(instance);
+        m_instance_data.push_back(data);
+      }
+    }
+    begin = end;
+  }
+
+  if (m_batches.empty()) {
+    return;
+  }
+
+  // everything instanced draw calls need is uploaded once per flush
+  ++m_buffers_version;
+  m_instance_data_buffer.upload(m_instance_data.data(),
+                                m_instance_data.size() * sizeof(InstanceData),
+                                m_buffers_version);
+  if (!m_bone_matrices.empty()) {
+    m_bone_matrices_buffer.upload(m_bone_matrices.data(),
+                                  m_bone_matrices.size() * sizeof(glm::mat3x4),
+                                  m_buffers_version);
+  }
+  if (!m_bone_dual_quaternions.empty()) {
+    m_bone_dual_quaternions_buffer.upload(
+        m_bone_dual_quaternions.data(),
+        m_bone_dual_quaternions.size() * sizeof(glm::mat2x4),
+        m_buffers_version);
+  }
+}
+
+unsigned int RenderQueue::add_palette(Instance &instance) {
+  if (instance.bone_offset) {
+    return *instance.bone_offset;
+  }
+
+  // meshes without bones get one identity bone, so the offset always points
+  // to a valid bone
+  static const std::vector<glm::mat3x4> identity_palette{glm::mat3x4(1.0f)};
+  const auto &bones = instance.mesh->bone_transformations().empty()
+                          ? identity_palette
+                          : instance.mesh->bone_transformations();
+
+  if (instance.mesh->skinning_mode() == SkinningMode::DualQuaternion) {
+    instance.bone_offset = m_bone_dual_quaternions.size();
+    for (const auto &bone_transformation : bones) {
+      m_bone_dual_quaternions.push_back(utility::convert_to_dual_quaternion(
+          utility::get_affine_matrix(bone_transformation)));
+    }
+  } else {
+    instance.bone_offset = m_bone_matrices.size();
+    m_bone_matrices.insert(m_bone_matrices.end(), bones.begin(), bones.end());
+  }
+  return *instance.bone_offset;
+}
+
+void RenderQueue::draw_batch(const Batch &batch) {
+  const auto &item = m_items[batch.begin];
+  const SkinnedMesh &mesh = *m_instances[item.instance].mesh;
+  Shader &shader = *item.shader;
+
+  bool dual_quaternions = mesh.skinning_mode() == SkinningMode::DualQuaternion;
+  shader.set_uniform(INSTANCED_UNIFORM, 1);
+  shader.set_uniform(INSTANCE_BASE_UNIFORM,
+                     static_cast<int>(batch.instance_base));
+  shader.set_uniform(USE_DUAL_QUATERNIONS_UNIFORM, dual_quaternions ? 1 : 0);
+
+  m_instance_data_buffer.bind(INSTANCE_DATA_BINDING);
+  if (dual_quaternions) {
+    m_bone_dual_quaternions_buffer.bind(BONE_DUAL_QUATERNIONS_BINDING);
+  } else {
+    m_bone_matrices_buffer.bind(BONE_MATRICES_BINDING);
+  }
+
+  mesh.draw_mesh_instanced(shader, item.mesh_id, batch.end - batch.begin,
+                           m_material_state);
+  ++m_stats.draw_calls;
+  ++m_stats.instanced_draw_calls;
+}
@@ -0,0 +1,125 @@
+#ifndef _RENDER_QUEUE_H_
+#define _RENDER_QUEUE_H_
+
+#include "bone_buffer.h"
+#include "camera.h"
+#include "light.h"
+#include "material.h"
+#include "shader.h"
+#include <GL/glew.h>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+class SkinnedMesh;
+
+// passes are drawn in this order
+enum class RenderPass : std::uint8_t { Opaque = 0, Effects = 1 };
+
+// state changes issued by the last flush
+struct RenderStats {
+  unsigned int draw_calls = 0;
+  // draw calls that draw more than one instance, included in draw_calls
+  unsigned int instanced_draw_calls = 0;
+  unsigned int program_binds = 0;
+  unsigned int vao_binds = 0;
+  unsigned int texture_binds = 0;
+};
+
+// draw calls of one frame
+// objects submit one item per mesh entry instead of drawing it right away,
+// flush sorts the items by their key and draws them, so consecutive draw calls
+// share as much state (program, material, vao) as possible and only the
+// changed state is bound
+// consecutive items that draw the same mesh entry of different copies (e.g.
+// enemies) are drawn with one instanced draw call, palettes of all such copies
+// are uploaded to one buffer and the shader finds the right one by the
+// instance id
+class RenderQueue {
+public:
+  struct DrawItem {
+    // packed sort key, see make_key
+    std::uint64_t key;
+    Shader *shader;
+    GLuint vao;
+    // instance index returned by add_instance
+    unsigned int instance;
+    unsigned int mesh_id;
+    // global transformation of the mesh node, it has to stay valid until the
+    // queue is flushed
+    const glm::mat4 *transformation;
+  };
+
+  // return sort key with pass in the highest bits followed by shader,
+  // material, vao and quantized distance from the camera (front to back)
+  static std::uint64_t make_key(RenderPass pass, const Shader &shader,
+                                unsigned int material_id, GLuint vao,
+                                float depth);
+
+  // add a skinned mesh copy drawn with the given transformation, mesh has to
+  // stay valid until the queue is flushed
+  unsigned int add_instance(const SkinnedMesh &mesh,
+                            const glm::mat4 &transformation);
+  void submit(const DrawItem &item);
+
+  // draw submitted items sorted by their keys and clear the queue
+  void flush(const Camera &camera, const Light &light);
+
+  // stats of the last flush
+  const RenderStats &stats() const { return m_stats; }
+
+private:
+  struct Instance {
+    const SkinnedMesh *mesh;
+    glm::mat4 transformation;
+    // offset of the instance's palette in the palettes of instanced draw
+    // calls, set once the instance is part of one
+    std::optional<unsigned int> bone_offset;
+  };
+
+  // data of one instance of an instanced draw call, laid out as InstanceData
+  // in skinned_mesh.vert (std430)
+  struct InstanceData {
+    glm::mat4 transformation;
+    int bone_offset;
+    int padding[3];
+  };
+
+  // items [begin, end) drawn with one instanced draw call, their data starts
+  // at instance_base in m_instance_data
+  struct Batch {
+    unsigned int begin;
+    unsigned int end;
+    unsigned int instance_base;
+  };
+
+  // return true if items can be drawn by the same instanced draw call
+  bool can_instance(const DrawItem &lhs, const DrawItem &rhs) const;
+  // find batches of sorted items and upload their instance data
+  void prepare_batches();
+  // return offset of the instance's palette, palette is added on the first
+  // call
+  unsigned int add_palette(Instance &instance);
+  void draw_batch(const Batch &batch);
+
+  std::vector<Instance> m_instances;
+  std::vector<DrawItem> m_items;
+
+  // ----------- instanced draw calls of the current flush -----------
+  std::vector<Batch> m_batches;
+  std::vector<InstanceData> m_instance_data;
+  std::vector<glm::mat3x4> m_bone_matrices;
+  std::vector<glm::mat2x4> m_bone_dual_quaternions;
+  // incremented on every upload of the buffers below
+  unsigned int m_buffers_version = 0;
+  BoneBuffer m_instance_data_buffer;
+  BoneBuffer m_bone_matrices_buffer;
+  BoneBuffer m_bone_dual_quaternions_buffer;
+  // -----------------------------------------------------------------
+
+  // material bindings are tracked across all the meshes of a flush
+  MaterialState m_material_state;
+  RenderStats m_stats;
+};
+
+#endif /* _RENDER_QUEUE_H_ */
@@ -5,6 +5,38 @@
 #include <iostream>
 #include <string>
 
+namespace {
+// registered uniform names, index of the name is its handle index
+std::vector<std::string> &get_uniform_names() {
+  // instantiated on first use, handles are registered during static
+  // initialization
+  static std::vector<std::string> s_uniform_names;
+  return s_uniform_names;
+}
+
+std::unordered_map<std::string, unsigned int> &get_uniform_names_index() {
+  static std::unordered_map<std::string, unsigned int> s_uniform_names_index;
+  return s_uniform_names_index;
+}
+} // namespace
+
+unsigned int Shader::uniform_location_queries = 0;
+
+unsigned int register_uniform_name(const std::string &uniform_name) {
+  auto &uniform_names = get_uniform_names();
+  auto inserted = get_uniform_names_index().emplace(uniform_name,
+                                                    uniform_names.size());
+  if (inserted.second) {
+    uniform_names.push_back(uniform_name);
+  }
+  return inserted.first->second;
+}
+
+const std::string &get_uniform_name(unsigned int index) {
+  assert(index < get_uniform_names().size() && "uniform index valid");
+  return get_uniform_names()[index];
+}
+
 std::string get_file_contents(const char *filename) {
   std::ifstream in(filename, std::ios::binary);
   if (in) {
@@ -48,6 +80,55 @@ Shader::Shader(const char *vertexFile, const char *fragmentFile) {
 
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
+
+  init_uniform_locations();
+}
+
+void Shader::init_uniform_locations() {
+  GLint uniforms_count = 0;
+  glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &uniforms_count);
+  GLint max_name_length = 0;
+  glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+  auto add_location = [this](const std::string &uniform_name) {
+    ++uniform_location_queries;
+    GLint location = glGetUniformLocation(m_id, uniform_name.c_str());
+    if (location != -1) {
+      m_uniform_locations.emplace(uniform_name, location);
+    }
+  };
+
+  std::vector<GLchar> name(max_name_length);
+  for (GLint i = 0; i < uniforms_count; ++i) {
+    GLsizei name_length = 0;
+    GLint size = 0;
+    GLenum type;
+    glGetActiveUniform(m_id, i, max_name_length, &name_length, &size, &type,
+                       name.data());
+    std::string uniform_name(name.data(), name_length);
+
+    // arrays are reported once as "name[0]", every element is added
+    auto bracket_position = uniform_name.find('[');
+    if (bracket_position == std::string::npos) {
+      add_location(uniform_name);
+    } else {
+      std::string array_name = uniform_name.substr(0, bracket_position);
+      for (GLint element = 0; element < size; ++element) {
+        add_location(array_name + "[" + std::to_string(element) + "]");
+      }
+    }
+  }
+}
+
+GLint Shader::get_location(unsigned int index) const {
+  // handles registered after the last lookup are resolved once
+  while (m_handle_locations.size() <= index) {
+    auto location_it = m_uniform_locations.find(
+        get_uniform_name(m_handle_locations.size()));
+    m_handle_locations.push_back(
+        location_it != m_uniform_locations.end() ? location_it->second : -1);
+  }
+  return m_handle_locations[index];
 }
 
 void Shader::activate() { glUseProgram(m_id); }
@@ -72,3 +153,11 @@ void Shader::compile_errors(unsigned int shader, const char *type) {
 }
 
 Shader::~Shader() { del(); }
+
+unsigned int Shader::uniform_location_queries_count() {
+  return uniform_location_queries;
+}
+
+void Shader::reset_uniform_location_queries_count() {
+  uniform_location_queries = 0;
+}
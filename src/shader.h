@@ -8,23 +8,65 @@
 #include <iostream>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 std::string get_file_contents(const char *filename);
 
+// return index of the uniform name shared by all the shaders, the same name
+// always gets the same index
+unsigned int register_uniform_name(const std::string &uniform_name);
+// return uniform name of the registered index
+const std::string &get_uniform_name(unsigned int index);
+
+// uniform name resolved once to a registered index, shaders keep locations of
+// the registered uniforms in a vector indexed by it, so setting a uniform
+// through a handle doesn't build strings or query the driver
+template <typename T> class UniformHandle {
+public:
+  using value_type = T;
+
+  explicit UniformHandle(const std::string &uniform_name)
+      : m_index(register_uniform_name(uniform_name)) {}
+
+  unsigned int index() const { return m_index; }
+
+private:
+  unsigned int m_index;
+};
+
 class Shader {
 public:
   Shader(const char *vertexFile, const char *fragmentFile);
   ~Shader();
 
+  // make sure shader is activated before seting uniform
   template <typename T>
-  void set_uniform(const std::string &uniform_name, T &&value) {
-    // make sure shader is activated before seting uniform
-    GLint uniform_location = glGetUniformLocation(m_id, uniform_name.data());
+  void set_uniform(const UniformHandle<T> &handle,
+                   const typename UniformHandle<T>::value_type &value) {
+    set_uniform_value(get_location(handle.index()), value);
+  }
+
+  // return true if the shader uses the uniform
+  template <typename T> bool has_uniform(const UniformHandle<T> &handle) const {
+    return get_location(handle.index()) != -1;
+  }
+
+  void activate();
+  void del();
+
+  GLuint id() const { return m_id; }
+
+  // number of glGetUniformLocation calls made by all the shaders since the
+  // last reset, locations are queried only when a shader is linked
+  static unsigned int uniform_location_queries_count();
+  static void reset_uniform_location_queries_count();
+
+private:
+  template <typename T>
+  static void set_uniform_value(GLint uniform_location, T &&value) {
     if (uniform_location == -1) {
-      // if uniform is unused, glsl compiler will remove it
-      // std::cout << "Uniform " << uniform_name << " not found or unused." <<
-      // std::endl;
       return;
     }
 
@@ -51,15 +93,24 @@ public:
     }
   }
 
-  void activate();
-  void del();
-
-  GLuint id() const { return m_id; }
+  // fill m_uniform_locations with all the active uniforms after linking
+  void init_uniform_locations();
+  // return location of the registered uniform (-1 if the shader doesn't use
+  // it)
+  GLint get_location(unsigned int index) const;
 
-private:
   void compile_errors(unsigned int shader, const char *type);
 
   GLuint m_id;
+
+  // uniform name -> location, array elements have their own entries
+  std::unordered_map<std::string, GLint> m_uniform_locations;
+  // registered uniform index -> location, extended when a handle registered
+  // after the last lookup is used
+  mutable std::vector<GLint> m_handle_locations;
+
+  // see uniform_location_queries_count
+  static unsigned int uniform_location_queries;
 };
 
 #endif /* _SHADER_H_ */
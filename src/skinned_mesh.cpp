@@ -10,7 +10,9 @@
 #include "utility.h"
 #include <assimp/material.h>
 #include <assimp/matrix4x4.h>
+#include <algorithm>
 #include <assimp/scene.h>
+#include <cmath>
 #include <cstddef>
 #include <glm/ext/scalar_constants.hpp>
 #include <glm/ext/vector_float3.hpp>
@@ -25,28 +27,80 @@
 #include <unordered_set>
 #include <vector>
 
-SkinnedMesh::SkinnedMesh(const std::string &filename)
+namespace {
+// name used to update the pose of the current transition
+const std::string TRANSITION_ANIMATION_NAME = "transition";
+// frames per second at which animations are sampled for their bounds
+const float BOUNDS_SAMPLE_RATE = 30.0f;
+// fraction of the bounds size added to each side of the sampled bounds
+const float BOUNDS_PADDING = 0.05f;
+// shader storage binding points of the bones palettes
+const GLuint BONE_MATRICES_BINDING = 0;
+const GLuint BONE_DUAL_QUATERNIONS_BINDING = 1;
+const UniformHandle<glm::vec3> CAM_POS_UNIFORM("camPos");
+const UniformHandle<glm::mat4> CAM_MATRIX_UNIFORM("camMatrix");
+const UniformHandle<glm::vec3> LIGHT_POS_UNIFORM("lightPos");
+const UniformHandle<glm::vec4> LIGHT_COLOR_UNIFORM("lightColor");
+const UniformHandle<glm::mat4> MODEL_UNIFORM("model");
+const UniformHandle<unsigned int> DRAW_INDEX_UNIFORM("gDrawIndex");
+const UniformHandle<int> USE_DUAL_QUATERNIONS_UNIFORM("gUseDualQuaternions");
+
+void set_local_transformation(TransformationNodeMutable &node_transform,
+                              const ChannelSample &sample) {
+  node_transform.local_transformation = sample.transformation;
+  node_transform.local_scaling = sample.scaling;
+  node_transform.local_translation = sample.translation;
+  node_transform.local_rotation = sample.rotation;
+}
+} // namespace
+
+unsigned int SkinnedMesh::recomputed_nodes_counter = 0;
+
+SkinnedMesh::SkinnedMesh(const std::string &filename,
+                         const AnimationImportSettings &animation_settings)
     : m_entries(std::make_shared<std::vector<MeshEntry>>()),
       m_materials(std::make_shared<std::vector<Material>>()),
+      m_material_buffer(),
       m_textures(std::make_shared<std::unordered_map<std::string, Texture>>()),
       m_bones(std::make_shared<std::vector<BoneInfo>>()),
       m_bone_index(
           std::make_shared<std::unordered_map<std::string, unsigned int>>()),
+      m_node_bones(std::make_shared<std::vector<int>>()),
       m_bones_bounding_boxes(
           std::make_shared<std::unordered_map<unsigned int, BoundingBox>>()),
       m_mesh_bounding_boxes(
           std::make_shared<std::unordered_map<unsigned int, BoundingBox>>()),
-      m_animations(
-          std::make_shared<std::unordered_map<std::string, Animation>>()),
-      m_positions(
-          std::make_shared<std::unordered_map<std::string, Animation>>()),
+      m_animations(std::make_shared<std::vector<Animation>>()),
+      m_animation_bounds(std::make_shared<std::vector<AnimationBounds>>()),
+      m_animation_index(
+          std::make_shared<std::unordered_map<std::string, unsigned int>>()),
+      m_positions(std::make_shared<std::vector<Animation>>()),
+      m_position_index(
+          std::make_shared<std::unordered_map<std::string, unsigned int>>()),
       m_transformation_tree(std::make_shared<TransformationTree>()),
       m_render_objects(
           std::make_shared<std::vector<const TransformationNode *>>()),
       m_nodes_to_render_object_index(
           std::make_shared<
               std::unordered_map<const TransformationNode *, unsigned int>>()),
-      m_node_transformations(), m_bone_transformations() {
+      m_pose_cache(animation_settings.bake_rate > 0.0f
+                       ? std::make_shared<PoseCache>(
+                             animation_settings.bake_rate,
+                             animation_settings.bake_memory_limit)
+                       : nullptr),
+      m_socket_nodes(std::make_shared<std::vector<unsigned int>>()),
+      m_socket_indices(std::make_shared<std::vector<int>>()),
+      m_node_transformations(), m_bone_transformations(),
+      m_channel_cursors(), m_pose_cache_animation(nullptr),
+      m_baked_animation(), m_baked_time(0.0f), m_pending_locals(false),
+      m_deferred_animation(nullptr), m_deferred_time(0.0f),
+      m_socket_transformations(), m_pose_layers(), m_current_bounds(nullptr),
+      m_current_bounds_valid(false), m_current_bounds_time(0.0f),
+      m_skinning_mode(SkinningMode::Matrix),
+      m_bones_version(0), m_bone_matrices_buffer(),
+      m_bone_dual_quaternions_buffer(), m_transition_start_pose(),
+      m_transition_end_pose(), m_transition_target(nullptr),
+      m_transition_duration(0.0f), m_transition_ignored_node(-1) {
 
   Assimp::Importer importer;
   const aiScene *scene = importer.ReadFile(
@@ -59,22 +113,32 @@ SkinnedMesh::SkinnedMesh(const std::string &filename)
 
   if (scene) {
     *m_transformation_tree = {scene->mRootNode, m_node_transformations};
-    init_from_scene(scene, filename);
+    init_from_scene(scene, filename, animation_settings);
   } else {
     printf("Error parsing '%s': '%s'\n", filename.c_str(),
            importer.GetErrorString());
   }
 }
 
-void SkinnedMesh::init_from_scene(const aiScene *scene,
-                                  const std::string &filename) {
+void SkinnedMesh::init_from_scene(
+    const aiScene *scene, const std::string &filename,
+    const AnimationImportSettings &animation_settings) {
   init_mesh_entries(scene);
-  // set bones aabb after initializing all the mesh entries
+  // set bones aabb and node bones after initializing all the mesh entries
   set_bones_bounding_boxes();
+  init_node_bones();
+  m_channel_cursors.resize(m_transformation_tree->nodes.size());
+  // all the nodes are computed once after loading
+  m_dirty_nodes.assign(m_transformation_tree->nodes.size(), true);
+  m_socket_indices = std::make_shared<std::vector<int>>(
+      m_transformation_tree->nodes.size(), -1);
+  m_transition_start_pose.resize(m_transformation_tree->nodes.size());
+  m_transition_end_pose.resize(m_transformation_tree->nodes.size());
   init_materials(scene, filename);
-  init_animations(scene);
+  init_animations(scene, animation_settings);
   init_render_objects(m_transformation_tree->root_node);
-  update_global_transformations(m_transformation_tree->root_node);
+  update_global_transformations();
+  init_animation_bounds();
 }
 
 void SkinnedMesh::init_mesh_entries(const aiScene *scene) {
@@ -203,8 +267,7 @@ void SkinnedMesh::init_materials(const aiScene *scene,
         if (texture_it == m_textures->end()) {
           texture_it = m_textures
                            ->emplace(full_path, Texture(full_path.c_str(),
-                                                        TextureType::DIFFUSE,
-                                                        m_textures->size()))
+                                                        TextureType::DIFFUSE))
                            .first;
         }
 
@@ -228,39 +291,56 @@ void SkinnedMesh::init_materials(const aiScene *scene,
       }
     }
   }
+
+  m_material_buffer = std::make_shared<const MaterialBuffer>(*m_materials);
 }
 
-void SkinnedMesh::init_animations(const aiScene *scene) {
+void SkinnedMesh::init_animations(const aiScene *scene,
+                                  const AnimationImportSettings &settings) {
+  // animations are referenced by pointers, so vectors are never reallocated
+  // after loading
   m_animations->reserve(scene->mNumAnimations);
+  m_positions->reserve(scene->mNumAnimations);
 
   for (int i = 0; i < scene->mNumAnimations; ++i) {
-    std::cout << std::string(scene->mAnimations[i]->mName.C_Str()) << std::endl;
-    if (scene->mAnimations[i]->mDuration == 0) {
-      // if duration is 0 it is position
-      m_positions->emplace(scene->mAnimations[i]->mName.C_Str(),
-                           scene->mAnimations[i]);
-    } else {
-      // if duration is greater than 0 it is animation
-      m_animations->emplace(scene->mAnimations[i]->mName.C_Str(),
-                            scene->mAnimations[i]);
+    // if duration is 0 it is position, otherwise it is animation
+    bool position = scene->mAnimations[i]->mDuration == 0;
+    auto &animations = position ? *m_positions : *m_animations;
+    auto &animation_index = position ? *m_position_index : *m_animation_index;
+
+    animation_index[scene->mAnimations[i]->mName.C_Str()] = animations.size();
+    animations.emplace_back(scene->mAnimations[i], settings);
+    // resolve node -> channel once, so that sampling doesn't need to find
+    // channels by node name
+    animations.back().bind(m_transformation_tree->nodes);
+
+    const auto &stats = animations.back().import_stats();
+    std::cout << animations.back().m_name << ": " << stats.keys_count
+              << " -> " << stats.imported_keys_count << " keys, "
+              << stats.constant_channels << "/"
+              << animations.back().m_channels.size()
+              << " channels are constant, " << stats.memory_size << " -> "
+              << stats.imported_memory_size << " bytes";
+    if (stats.imported_memory_size < stats.memory_size) {
+      std::cout << " (" << stats.memory_size - stats.imported_memory_size
+                << " saved)";
     }
+    std::cout << std::endl;
   }
 }
 
 TransformationNodeMutable &
 SkinnedMesh::get_node_transformation(const TransformationNode *node) {
-  auto node_transformations_it = m_node_transformations.find(node);
-  assert(node_transformations_it != m_node_transformations.end() &&
+  assert(node->index < m_node_transformations.size() &&
          "node transformation exists");
-  return node_transformations_it->second;
+  return m_node_transformations[node->index];
 }
 
 const TransformationNodeMutable &
 SkinnedMesh::get_node_transformation(const TransformationNode *node) const {
-  auto node_transformations_it = m_node_transformations.find(node);
-  assert(node_transformations_it != m_node_transformations.end() &&
+  assert(node->index < m_node_transformations.size() &&
          "node transformation exists");
-  return node_transformations_it->second;
+  return m_node_transformations[node->index];
 }
 
 void SkinnedMesh::init_render_objects(
@@ -278,83 +358,133 @@ void SkinnedMesh::init_render_objects(
   }
 }
 
-void SkinnedMesh::update_global_transformations(
-    const std::unique_ptr<TransformationNode> &node,
-    const glm::mat4 &parent_transform) {
-  assert(node && "node is not null");
+void SkinnedMesh::init_node_bones() {
+  // resolve bone index of each node once, so it doesn't need to be looked up
+  // by name during every update
+  const auto &nodes = m_transformation_tree->nodes;
+  m_node_bones->resize(nodes.size());
+  for (unsigned int i = 0; i < nodes.size(); ++i) {
+    const auto &bone_index = get_bone_index(nodes[i]->name);
+    (*m_node_bones)[i] = bone_index ? static_cast<int>(*bone_index) : -1;
+  }
+}
 
-  auto &node_transformations = get_node_transformation(node.get());
+void SkinnedMesh::mark_dirty(unsigned int node_index) {
+  assert(node_index < m_dirty_nodes.size() && "node index valid");
+  m_dirty_nodes[node_index] = true;
+}
 
-  node_transformations.global_transformation =
-      parent_transform * node_transformations.local_transformation;
+void SkinnedMesh::update_global_transformations() {
+  const auto &subtree_ends = m_transformation_tree->subtree_ends;
 
-  const auto &bone_index = get_bone_index(node->name);
+  // clean subtrees are skipped, so meshes that are not changed after loading
+  // never recompute their nodes
+  for (unsigned int i = 0; i < m_dirty_nodes.size();) {
+    if (!m_dirty_nodes[i]) {
+      ++i;
+      continue;
+    }
 
-  if (bone_index) {
-    m_bone_transformations[*bone_index] =
-        node_transformations.global_transformation *
-        (*m_bones)[*bone_index].offset;
+    update_global_transformations(i);
+    i = subtree_ends[i];
   }
+}
 
-  for (const auto &child : node->children) {
-    update_global_transformations(child,
-                                  node_transformations.global_transformation);
+void SkinnedMesh::update_global_transformations(unsigned int node_index) {
+  const auto &parents = m_transformation_tree->parents;
+  unsigned int subtree_end = m_transformation_tree->subtree_ends[node_index];
+  recomputed_nodes_counter += subtree_end - node_index;
+  ++m_bones_version;
+
+  std::fill(m_dirty_nodes.begin() + node_index,
+            m_dirty_nodes.begin() + subtree_end, false);
+  // root's local transformation is not applied to the hierarchy, the same
+  // as in the animation passes
+  utility::concatenate_pose(m_node_transformations, parents, *m_node_bones,
+                            *m_bones, m_bone_transformations, node_index,
+                            subtree_end);
+}
+
+void SkinnedMesh::clear_dirty_nodes() {
+  std::fill(m_dirty_nodes.begin(), m_dirty_nodes.end(), false);
+}
+
+ClipId SkinnedMesh::get_clip_id(const std::string &animation_name) const {
+  if (animation_name == TRANSITION_ANIMATION_NAME) {
+    return TRANSITION_CLIP;
   }
+
+  auto animation_it = m_animation_index->find(animation_name);
+  assert(animation_it != m_animation_index->end() &&
+         "animation name is valid");
+  return {animation_it->second};
+}
+
+PositionId
+SkinnedMesh::get_position_id(const std::string &position_name) const {
+  auto position_it = m_position_index->find(position_name);
+  assert(position_it != m_position_index->end() && "position name is valid");
+  return {position_it->second};
 }
 
 glm::mat4
 SkinnedMesh::get_bones_for_position(const std::string &position_name) {
-  auto position_it = m_positions->find(position_name);
-  assert(position_it != m_positions->end() && "position name is valid");
-  auto &position = position_it->second;
+  return get_bones_for_position(get_position_id(position_name));
+}
 
-  auto root_global_transform = calculate_bones_transformations(
-      position, 0, *m_transformation_tree->root_node, glm::mat4(1.0));
+glm::mat4 SkinnedMesh::get_bones_for_position(PositionId position_id) {
+  assert(position_id.index < m_positions->size() && "position id is valid");
+  const auto &position = (*m_positions)[position_id.index];
+
+  evaluate_deferred_pose();
+  invalidate_baked_pose();
+  m_current_bounds = nullptr;
+  auto root_global_transform = calculate_bones_transformations(position, 0);
+  apply_pose_layers();
 
   return root_global_transform;
 }
 
-glm::mat4 SkinnedMesh::get_final_global_transformation_for_animation(
-    const std::string &animation_name) {
-  auto animation_it = m_animations->find(animation_name);
-  assert(animation_it != m_animations->end() && "animation name is valid");
-  auto &animation = animation_it->second;
-
-  float animation_time = animation.m_duration;
+RootMotion SkinnedMesh::get_root_motion(ClipId clip_id, float time,
+                                        float speed_factor) const {
+  assert(clip_id.index < m_animations->size() && "clip id is valid");
+  const auto &animation = (*m_animations)[clip_id.index];
 
-  Channel *channel =
-      animation.get_channel(m_transformation_tree->root_node->name);
-  if (channel) {
-    channel->update(animation_time);
-    return channel->get_local_transform();
-  }
-
-  return get_node_transformation(m_transformation_tree->root_node.get())
-      .local_transformation;
+  return animation.get_root_motion(
+      animation.get_animation_time(time, speed_factor));
 }
 
 std::pair<bool, glm::mat4>
 SkinnedMesh::get_bones_for_animation(const std::string &animation_name,
                                      float time, float speed_factor) {
-  Animation *animation = nullptr;
-  auto animation_it = m_animations->find(animation_name);
-  if (animation_it == m_animations->end()) {
-    for (auto &transition_animation : m_transitions_animations) {
-      if (transition_animation.m_name == animation_name) {
-        animation = &transition_animation;
-        break;
-      }
-    }
-  } else {
-    animation = &animation_it->second;
+  return get_bones_for_animation(get_clip_id(animation_name), time,
+                                 speed_factor);
+}
+
+std::pair<bool, glm::mat4>
+SkinnedMesh::get_bones_for_animation(ClipId clip_id, float time,
+                                     float speed_factor, bool defer_pose) {
+  if (clip_id == TRANSITION_CLIP) {
+    assert(m_transition_target && "transition is created");
+    return update_transition(time, speed_factor);
   }
-  assert(animation && "animation name is valid");
+  assert(clip_id.index < m_animations->size() && "clip id is valid");
+  const Animation *animation = &(*m_animations)[clip_id.index];
 
   float animation_time = animation->get_animation_time(time, speed_factor);
 
-  auto root_global_transform = calculate_bones_transformations(
-      *animation, animation_time, *m_transformation_tree->root_node,
-      glm::mat4(1.0f));
+  glm::mat4 root_global_transform =
+      defer_pose ? defer_bones_transformations(*animation, animation_time)
+                 : evaluate_bones_transformations(*animation, animation_time);
+  const AnimationBounds *bounds = &(*m_animation_bounds)[clip_id.index];
+  if (bounds != m_current_bounds) {
+    // base pose is checked only when the animation starts, it's not changed
+    // while the animation is played
+    m_current_bounds = bounds;
+    m_current_bounds_valid =
+        get_base_pose_hash(*animation) == bounds->base_pose;
+  }
+  m_current_bounds_time = animation_time;
 
   bool animation_finished = time < 0 ? animation_time == 0.0f
                                      : animation_time == animation->m_duration;
@@ -362,49 +492,480 @@ SkinnedMesh::get_bones_for_animation(const std::string &animation_name,
   return {animation_finished, std::move(root_global_transform)};
 }
 
-glm::mat4 SkinnedMesh::calculate_bones_transformations(
-    Animation &animation, float animation_time, TransformationNode &node,
-    const glm::mat4 &parent_transform) {
+glm::mat4
+SkinnedMesh::calculate_bones_transformations(const Animation &animation,
+                                             float animation_time) {
+  const auto &nodes = m_transformation_tree->nodes;
+  const auto &parents = m_transformation_tree->parents;
+
+  // root is always the first node, its local transformation is not applied to
+  // the hierarchy but returned as global transformation of the whole object
+  auto &root_transform = m_node_transformations[0];
+  glm::mat4 root_global_transform = root_transform.local_transformation;
+
+  // channels are shared by all the mesh copies, so they are sampled into
+  // this copy's own sample
+  ChannelSample sample;
+
+  if (animation.sample(0, animation_time, sample, m_channel_cursors[0])) {
+    root_global_transform = sample.transformation;
+  }
+  root_transform.global_transformation = glm::mat4(1.0f);
+  recomputed_nodes_counter += nodes.size();
+  ++m_bones_version;
+  clear_dirty_nodes();
+
+  for (unsigned int i = 1; i < nodes.size(); ++i) {
+    if (animation.sample(i, animation_time, sample, m_channel_cursors[i])) {
+      set_local_transformation(m_node_transformations[i], sample);
+    }
+  }
+  utility::concatenate_pose(m_node_transformations, parents, *m_node_bones,
+                            *m_bones, m_bone_transformations, 0, nodes.size());
+
+  return root_global_transform;
+}
+
+glm::mat4
+SkinnedMesh::evaluate_bones_transformations(const Animation &animation,
+                                            float animation_time) {
+  if (m_deferred_animation == &animation) {
+    // deferred pose is replaced by the new one
+    m_deferred_animation = nullptr;
+  } else {
+    // previous animation's pose is the base pose of this animation
+    evaluate_deferred_pose();
+  }
 
-  // take a reference to node transform in order to save new transformation
-  // if needed
-  auto &node_transform = get_node_transformation(&node);
-  glm::mat4 root_global_transform = node_transform.local_transformation;
+  glm::mat4 root_global_transform;
+  if (m_pose_cache) {
+    root_global_transform =
+        get_cached_bones_transformations(animation, animation_time);
+  } else {
+    invalidate_baked_pose();
+    root_global_transform =
+        calculate_bones_transformations(animation, animation_time);
+  }
+  // layers are not baked, they are applied on top of the evaluated pose
+  apply_pose_layers();
 
-  Channel *channel = animation.get_channel(node.name);
-  if (channel) {
-    channel->update(animation_time);
+  return root_global_transform;
+}
 
-    if (node.name == m_transformation_tree->root_node->name) {
-      root_global_transform = channel->get_local_transform();
-    } else {
-      node_transform.local_transformation = channel->get_local_transform();
-      node_transform.local_scaling = channel->get_local_scaling();
-      node_transform.local_translation = channel->get_local_translation();
-      node_transform.local_rotation = channel->get_local_rotation();
+glm::mat4 SkinnedMesh::get_root_transformation(const Animation &animation,
+                                               float animation_time) {
+  ChannelSample sample;
+  if (animation.sample(0, animation_time, sample, m_channel_cursors[0])) {
+    return sample.transformation;
+  }
+  return m_node_transformations[0].local_transformation;
+}
+
+glm::mat4
+SkinnedMesh::defer_bones_transformations(const Animation &animation,
+                                         float animation_time) {
+  if (m_deferred_animation && m_deferred_animation != &animation) {
+    evaluate_deferred_pose();
+  }
+  if (m_pose_cache_animation != &animation) {
+    // locals of the baked animation are needed as base pose of this one
+    apply_pending_locals();
+  }
+
+  m_deferred_animation = &animation;
+  m_deferred_time = animation_time;
+  evaluate_socket_nodes();
+
+  return get_root_transformation(animation, animation_time);
+}
+
+void SkinnedMesh::evaluate_pose() { evaluate_deferred_pose(); }
+
+void SkinnedMesh::evaluate_deferred_pose() {
+  if (!m_deferred_animation) {
+    return;
+  }
+
+  const Animation *animation = m_deferred_animation;
+  m_deferred_animation = nullptr;
+  evaluate_bones_transformations(*animation, m_deferred_time);
+}
+
+void SkinnedMesh::get_current_local_sample(unsigned int node_index,
+                                           ChannelSample &sample) const {
+  // root's local transformation is not changed by animations
+  if (node_index != 0) {
+    ChannelCursor cursor;
+    if (m_deferred_animation &&
+        m_deferred_animation->sample(node_index, m_deferred_time, sample,
+                                     cursor)) {
+      return;
+    }
+
+    // local transformation of animated node is not set while baked animation
+    // is used
+    if (m_pending_locals &&
+        m_pose_cache_animation->sample(node_index, m_baked_time, sample,
+                                       cursor)) {
+      return;
     }
   }
 
-  node_transform.global_transformation =
-      (node.name == m_transformation_tree->root_node->name)
-          ? parent_transform
-          : parent_transform * node_transform.local_transformation;
+  const auto &node_transform = m_node_transformations[node_index];
+  sample.translation = node_transform.local_translation;
+  sample.rotation = node_transform.local_rotation;
+  sample.scaling = node_transform.local_scaling;
+  sample.transformation = node_transform.local_transformation;
+}
 
-  const auto &bone_index = get_bone_index(node.name);
+glm::mat4
+SkinnedMesh::get_current_local_transformation(unsigned int node_index) const {
+  ChannelSample sample;
+  get_current_local_sample(node_index, sample);
+  blend_pose_layers(node_index, sample);
+  return sample.transformation;
+}
 
-  if (bone_index) {
-    m_bone_transformations[*bone_index] =
-        node_transform.global_transformation * (*m_bones)[*bone_index].offset;
+glm::mat4
+SkinnedMesh::get_current_global_transformation(unsigned int node_index) const {
+  if (!m_deferred_animation) {
+    return m_node_transformations[node_index].global_transformation;
+  }
+
+  // deferred pose evaluates only the socket chains, other nodes would need
+  // their whole chain sampled on every query
+  int socket_index = (*m_socket_indices)[node_index];
+  assert(socket_index >= 0 &&
+         "only socket nodes are queried while the pose is deferred");
+  if (socket_index >= 0) {
+    return m_socket_transformations[socket_index];
+  }
+
+  // root's global transformation is identity, so only the transformations
+  // below the root are multiplied, the chain is walked from the node up, so
+  // it doesn't need to be stored
+  const auto &parents = m_transformation_tree->parents;
+  glm::mat4 global_transformation(1.0f);
+  for (int i = node_index; i > 0; i = parents[i]) {
+    ++recomputed_nodes_counter;
+    global_transformation = utility::multiply_affine(
+        get_current_local_transformation(i), global_transformation);
   }
 
-  for (const auto &child : node.children) {
-    calculate_bones_transformations(animation, animation_time, *child,
-                                    node_transform.global_transformation);
+  return global_transformation;
+}
+
+void SkinnedMesh::evaluate_socket_nodes() {
+  const auto &parents = m_transformation_tree->parents;
+
+  // parents are before their children, so parent's global transformation is
+  // always evaluated first
+  ChannelSample sample;
+  recomputed_nodes_counter += m_socket_nodes->size();
+  for (unsigned int i = 0; i < m_socket_nodes->size(); ++i) {
+    unsigned int node_index = (*m_socket_nodes)[i];
+    glm::mat4 local_transformation;
+    if (m_deferred_animation->sample(node_index, m_deferred_time, sample,
+                                     m_channel_cursors[node_index])) {
+      blend_pose_layers(node_index, sample);
+      local_transformation = sample.transformation;
+    } else {
+      local_transformation = get_current_local_transformation(node_index);
+    }
+
+    int parent_index = parents[node_index];
+    m_socket_transformations[i] =
+        parent_index == 0
+            ? local_transformation
+            : utility::multiply_affine(
+                  m_socket_transformations[(*m_socket_indices)[parent_index]],
+                  local_transformation);
   }
+}
+
+std::pair<bool, glm::mat4> SkinnedMesh::update_transition(float time,
+                                                         float speed_factor) {
+  // transition duration is in seconds, for reversed time see
+  // Animation::get_animation_time
+  float transition_time = (time >= 0 ? time : -time - 1) * speed_factor;
+  if (time < 0) {
+    transition_time = std::max(m_transition_duration - transition_time, 0.0f);
+  } else {
+    transition_time = std::min(transition_time, m_transition_duration);
+  }
+  bool transition_finished = time < 0
+                                 ? transition_time == 0.0f
+                                 : transition_time == m_transition_duration;
+
+  // transitions are short and depend on this copy's pose, so their pose is
+  // never deferred, baked or bounded
+  evaluate_deferred_pose();
+  invalidate_baked_pose();
+  m_current_bounds = nullptr;
+
+  float weight = m_transition_duration > 0.0f
+                     ? transition_time / m_transition_duration
+                     : 1.0f;
+  glm::mat4 root_global_transform =
+      calculate_transition_transformations(weight);
+  apply_pose_layers();
+
+  return {transition_finished, std::move(root_global_transform)};
+}
+
+glm::mat4 SkinnedMesh::calculate_transition_transformations(float weight) {
+  const auto &nodes = m_transformation_tree->nodes;
+  const auto &parents = m_transformation_tree->parents;
+
+  // blend between start and end local transformations of the node
+  ChannelSample sample;
+  auto blend = [this, weight, &sample](unsigned int node_index) {
+    const auto &start = m_transition_start_pose[node_index];
+    const auto &end = m_transition_end_pose[node_index];
+    sample.translation = glm::mix(start.translation, end.translation, weight);
+    sample.rotation =
+        glm::normalize(glm::slerp(start.rotation, end.rotation, weight));
+    sample.scaling = glm::mix(start.scaling, end.scaling, weight);
+    sample.transformation = utility::compose_transformation(
+        sample.translation, sample.rotation, sample.scaling);
+  };
+
+  // root's local transformation is not applied to the hierarchy but returned
+  // as global transformation of the whole object
+  blend(0);
+  glm::mat4 root_global_transform = sample.transformation;
+  m_node_transformations[0].global_transformation = glm::mat4(1.0f);
+  recomputed_nodes_counter += nodes.size();
+  ++m_bones_version;
+  clear_dirty_nodes();
+
+  for (unsigned int i = 1; i < nodes.size(); ++i) {
+    if (static_cast<int>(i) != m_transition_ignored_node) {
+      blend(i);
+      set_local_transformation(m_node_transformations[i], sample);
+    }
+  }
+  utility::concatenate_pose(m_node_transformations, parents, *m_node_bones,
+                            *m_bones, m_bone_transformations, 0, nodes.size());
 
   return root_global_transform;
 }
 
+void SkinnedMesh::blend_pose_layers(unsigned int node_index,
+                                    ChannelSample &sample) const {
+  bool blended = false;
+  for (const auto &layer : m_pose_layers) {
+    if (layer.node_index != node_index || layer.weight == 0.0f) {
+      continue;
+    }
+
+    if (layer.mode == PoseLayerMode::Additive) {
+      sample.rotation *= glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                                    layer.rotation, layer.weight);
+    } else {
+      sample.rotation =
+          glm::slerp(sample.rotation, layer.rotation, layer.weight);
+    }
+    blended = true;
+  }
+
+  if (blended) {
+    sample.transformation = utility::compose_transformation(
+        sample.translation, sample.rotation, sample.scaling);
+  }
+}
+
+void SkinnedMesh::apply_pose_layers() {
+  for (unsigned int i = 0; i < m_pose_layers.size(); ++i) {
+    // all layers of a node are applied at once
+    bool node_updated =
+        i > 0 && m_pose_layers[i - 1].node_index == m_pose_layers[i].node_index;
+    if (!node_updated && is_active(m_pose_layers[i])) {
+      update_layered_node(m_pose_layers[i].node_index);
+    }
+  }
+}
+
+void SkinnedMesh::update_layered_node(unsigned int node_index) {
+  assert(node_index > 0 && "root is not layered");
+  const auto &parents = m_transformation_tree->parents;
+
+  // subtree is rebuilt from its parent's global transformation and the
+  // current local transformations, subtree is contiguous and parents are
+  // before their children
+  unsigned int subtree_end = m_transformation_tree->subtree_ends[node_index];
+  recomputed_nodes_counter += subtree_end - node_index;
+  ++m_bones_version;
+  for (unsigned int i = node_index; i < subtree_end; ++i) {
+    m_dirty_nodes[i] = false;
+    auto &transform = m_node_transformations[i];
+    transform.global_transformation = utility::multiply_affine(
+        m_node_transformations[parents[i]].global_transformation,
+        get_current_local_transformation(i));
+
+    int bone_index = (*m_node_bones)[i];
+    if (bone_index >= 0) {
+      m_bone_transformations[bone_index] = utility::multiply_affine_rows(
+          transform.global_transformation, (*m_bones)[bone_index].offset);
+    }
+  }
+}
+
+bool SkinnedMesh::is_active(const PoseLayer &layer) {
+  return layer.weight > 0.0f &&
+         (layer.mode == PoseLayerMode::Override ||
+          layer.rotation != glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+}
+
+glm::mat4
+SkinnedMesh::get_cached_bones_transformations(const Animation &animation,
+                                              float animation_time) {
+  if (m_pose_cache_animation != &animation) {
+    // animation starts from the pose left by the previous one, look up the
+    // animation baked for that base pose
+    invalidate_baked_pose();
+    PoseCache::Key key{&animation, get_base_pose_hash(animation)};
+    std::size_t memory_size = BakedAnimation::get_memory_size(
+        m_pose_cache->get_frame_count(animation),
+        m_transformation_tree->nodes.size(), m_bone_transformations.size());
+    m_baked_animation =
+        m_pose_cache->get(key, memory_size, [this, &animation]() {
+          return bake_animation(animation);
+        });
+    m_pose_cache_animation = &animation;
+  }
+
+  if (!m_baked_animation) {
+    return calculate_bones_transformations(animation, animation_time);
+  }
+
+  // pending locals are sampled at the baked frame's time, so they match the
+  // baked global transformations
+  m_baked_time = set_baked_pose(*m_baked_animation, animation_time);
+  m_pending_locals = true;
+
+  // root transformation is not baked because it moves the whole object
+  return get_root_transformation(animation, animation_time);
+}
+
+BakedAnimation SkinnedMesh::bake_animation(const Animation &animation) {
+  const auto &nodes = m_transformation_tree->nodes;
+
+  BakedAnimation baked_animation;
+  baked_animation.frame_count = m_pose_cache->get_frame_count(animation);
+  baked_animation.frame_duration =
+      baked_animation.frame_count > 1
+          ? animation.m_duration / (baked_animation.frame_count - 1)
+          : 0.0f;
+  baked_animation.node_transformations.reserve(baked_animation.frame_count *
+                                               nodes.size());
+  baked_animation.bone_transformations.reserve(
+      baked_animation.frame_count * m_bone_transformations.size());
+
+  // animation is evaluated on this copy's pose, which is restored afterwards
+  auto node_transformations = m_node_transformations;
+  auto bone_transformations = m_bone_transformations;
+  auto channel_cursors = m_channel_cursors;
+
+  for (unsigned int f = 0; f < baked_animation.frame_count; ++f) {
+    calculate_bones_transformations(
+        animation, std::min(f * baked_animation.frame_duration,
+                            animation.m_duration));
+    for (const auto *node : nodes) {
+      baked_animation.node_transformations.push_back(
+          get_node_transformation(node).global_transformation);
+    }
+    baked_animation.bone_transformations.insert(
+        baked_animation.bone_transformations.end(),
+        m_bone_transformations.begin(), m_bone_transformations.end());
+  }
+
+  m_node_transformations = std::move(node_transformations);
+  m_bone_transformations = std::move(bone_transformations);
+  m_channel_cursors = std::move(channel_cursors);
+
+  return baked_animation;
+}
+
+float SkinnedMesh::set_baked_pose(const BakedAnimation &baked_animation,
+                                  float animation_time) {
+  const auto &nodes = m_transformation_tree->nodes;
+  unsigned int bones_count = m_bone_transformations.size();
+
+  // the nearest frame is used, componentwise interpolation of two matrices
+  // isn't a rigid transformation and would shrink rotating bones
+  unsigned int frame = 0;
+  if (baked_animation.frame_count > 1) {
+    float frame_position = std::clamp(
+        animation_time / baked_animation.frame_duration, 0.0f,
+        static_cast<float>(baked_animation.frame_count - 1));
+    frame = static_cast<unsigned int>(std::lround(frame_position));
+  }
+
+  recomputed_nodes_counter += nodes.size();
+  ++m_bones_version;
+  clear_dirty_nodes();
+  for (unsigned int i = 0; i < nodes.size(); ++i) {
+    m_node_transformations[i].global_transformation =
+        baked_animation.node_transformations[frame * nodes.size() + i];
+  }
+  for (unsigned int i = 0; i < bones_count; ++i) {
+    m_bone_transformations[i] =
+        baked_animation.bone_transformations[frame * bones_count + i];
+  }
+
+  return std::min(frame * baked_animation.frame_duration,
+                  m_pose_cache_animation->m_duration);
+}
+
+void SkinnedMesh::apply_pending_locals() {
+  if (!m_pending_locals) {
+    return;
+  }
+  m_pending_locals = false;
+
+  // root's local transformation is not changed by animations
+  const auto &nodes = m_transformation_tree->nodes;
+  ChannelSample sample;
+  for (unsigned int i = 1; i < nodes.size(); ++i) {
+    if (m_pose_cache_animation->sample(i, m_baked_time, sample,
+                                       m_channel_cursors[i])) {
+      set_local_transformation(m_node_transformations[i], sample);
+    }
+  }
+}
+
+void SkinnedMesh::invalidate_baked_pose() {
+  apply_pending_locals();
+  m_pose_cache_animation = nullptr;
+  m_baked_animation.reset();
+}
+
+std::size_t SkinnedMesh::get_base_pose_hash(const Animation &animation) const {
+  const auto &nodes = m_transformation_tree->nodes;
+
+  // transformations are rounded, so that poses which differ only because of
+  // floating point errors have the same hash
+  std::size_t hash = 0;
+  for (unsigned int i = 1; i < nodes.size(); ++i) {
+    if (animation.get_channel(i)) {
+      continue;
+    }
+
+    const auto &local_transformation =
+        m_node_transformations[i].local_transformation;
+    for (unsigned int c = 0; c < 4; ++c) {
+      for (unsigned int r = 0; r < 4; ++r) {
+        long value = std::lround(local_transformation[c][r] * 1e4f);
+        hash ^= std::hash<long>()(value) + 0x9e3779b9 + (hash << 6) +
+                (hash >> 2);
+      }
+    }
+  }
+
+  return hash;
+}
+
 std::vector<unsigned int>
 SkinnedMesh::get_render_object_ids(const std::string &node_name) const {
   auto node_ptr_it = m_transformation_tree->nodes_index.find(node_name);
@@ -439,54 +1000,142 @@ SkinnedMesh::get_render_object_ids(const std::string &node_name) const {
   return render_object_ids;
 }
 
-void SkinnedMesh::rotate_bone(const std::string &bone_name,
-                              const glm::quat &q) {
-  auto node_ptr_it = m_transformation_tree->nodes_index.find(bone_name);
+unsigned int SkinnedMesh::add_pose_layer(const std::string &node_name,
+                                         PoseLayerMode mode) {
+  auto node_ptr_it = m_transformation_tree->nodes_index.find(node_name);
   assert(node_ptr_it != m_transformation_tree->nodes_index.end() &&
          "node name valid");
-  auto &node_transform = get_node_transformation(node_ptr_it->second);
-  node_transform.local_rotation *= q;
-  auto translation =
-      glm::translate(glm::mat4(1.0f), node_transform.local_translation);
-  auto scaling = glm::scale(glm::mat4(1.0f), node_transform.local_scaling);
-  auto rotation = glm::mat4(node_transform.local_rotation);
-  node_transform.local_transformation = translation * rotation * scaling;
-  // TODO improve performance by updating only children
-  update_global_transformations(m_transformation_tree->root_node);
+  unsigned int node_index = node_ptr_it->second->index;
+  assert(node_index != 0 && "root node is not layered");
+  // parent's layers have to be applied before children's
+  assert((m_pose_layers.empty() ||
+          m_pose_layers.back().node_index <= node_index) &&
+         "layers added in depth-first order");
+
+  m_pose_layers.push_back({node_index, mode});
+  return m_pose_layers.size() - 1;
+}
+
+unsigned int SkinnedMesh::get_pose_layer(const std::string &node_name) const {
+  auto node_ptr_it = m_transformation_tree->nodes_index.find(node_name);
+  assert(node_ptr_it != m_transformation_tree->nodes_index.end() &&
+         "node name valid");
+  for (unsigned int i = 0; i < m_pose_layers.size(); ++i) {
+    if (m_pose_layers[i].node_index == node_ptr_it->second->index) {
+      return i;
+    }
+  }
+
+  assert(false && "pose layer exists");
+  return 0;
+}
+
+void SkinnedMesh::set_pose_layer(unsigned int layer_index,
+                                 const glm::quat &rotation, float weight) {
+  assert(layer_index < m_pose_layers.size() && "valid layer index");
+  auto &layer = m_pose_layers[layer_index];
+  layer.rotation = rotation;
+  layer.weight = weight;
+
+  // deferred pose gets layers when it's evaluated, only its socket nodes are
+  // up to date
+  if (m_deferred_animation) {
+    evaluate_socket_nodes();
+  } else {
+    update_layered_node(layer.node_index);
+  }
+}
+
+void SkinnedMesh::set_socket_nodes(
+    const std::vector<std::string> &node_names) {
+  const auto &parents = m_transformation_tree->parents;
+
+  // mark sockets and their ancestors, root's global transformation is always
+  // identity so it's not included
+  std::vector<bool> is_socket_node(parents.size(), false);
+  for (const auto &node_name : node_names) {
+    auto node_ptr_it = m_transformation_tree->nodes_index.find(node_name);
+    assert(node_ptr_it != m_transformation_tree->nodes_index.end() &&
+           "node name valid");
+    for (int i = node_ptr_it->second->index; i > 0; i = parents[i]) {
+      is_socket_node[i] = true;
+    }
+  }
+
+  auto socket_nodes = std::make_shared<std::vector<unsigned int>>();
+  auto socket_indices = std::make_shared<std::vector<int>>(parents.size(), -1);
+  for (unsigned int i = 0; i < parents.size(); ++i) {
+    if (is_socket_node[i]) {
+      (*socket_indices)[i] = socket_nodes->size();
+      socket_nodes->push_back(i);
+    }
+  }
+
+  m_socket_nodes = std::move(socket_nodes);
+  m_socket_indices = std::move(socket_indices);
+  m_socket_transformations.resize(m_socket_nodes->size());
+  if (m_deferred_animation) {
+    evaluate_socket_nodes();
+  }
 }
 
 void SkinnedMesh::scale_node(const std::string &node_name,
                              const glm::vec3 &scaling_vector) {
+  evaluate_deferred_pose();
+  invalidate_baked_pose();
   auto node_ptr_it = m_transformation_tree->nodes_index.find(node_name);
   assert(node_ptr_it != m_transformation_tree->nodes_index.end() &&
          "node name valid");
   auto &node_transform = get_node_transformation(node_ptr_it->second);
   node_transform.local_scaling *= scaling_vector;
-  auto translation =
-      glm::translate(glm::mat4(1.0f), node_transform.local_translation);
-  auto scaling = glm::scale(glm::mat4(1.0f), node_transform.local_scaling);
-  auto rotation = glm::mat4(node_transform.local_rotation);
-  node_transform.local_transformation = translation * rotation * scaling;
-  // TODO improve performance by updating only children
-  update_global_transformations(m_transformation_tree->root_node);
+  node_transform.local_transformation = utility::compose_transformation(
+      node_transform.local_translation, node_transform.local_rotation,
+      node_transform.local_scaling);
+  // only the scaled node's subtree is recomputed
+  mark_dirty(node_ptr_it->second->index);
+  m_current_bounds = nullptr;
+  update_global_transformations();
+  apply_pose_layers();
 }
 
-const glm::mat4 &
+void SkinnedMesh::set_skinning_mode(SkinningMode skinning_mode) {
+  m_skinning_mode = skinning_mode;
+}
+
+unsigned int SkinnedMesh::recomputed_nodes_count() {
+  return recomputed_nodes_counter;
+}
+
+void SkinnedMesh::reset_recomputed_nodes_count() {
+  recomputed_nodes_counter = 0;
+}
+
+glm::mat4
 SkinnedMesh::node_global_transformation(const std::string &node_name) const {
   auto node_ptr_it = m_transformation_tree->nodes_index.find(node_name);
   assert(node_ptr_it != m_transformation_tree->nodes_index.end() &&
          "node name valid");
-  const auto &node_transform = get_node_transformation(node_ptr_it->second);
-  return node_transform.global_transformation;
+  return get_current_global_transformation(node_ptr_it->second->index);
 }
 
-const glm::mat4 &
+glm::mat4
 SkinnedMesh::node_local_transformation(const std::string &node_name) const {
   auto node_ptr_it = m_transformation_tree->nodes_index.find(node_name);
   assert(node_ptr_it != m_transformation_tree->nodes_index.end() &&
          "node name valid");
-  const auto &node_transform = get_node_transformation(node_ptr_it->second);
-  return node_transform.local_transformation;
+
+  return get_current_local_transformation(node_ptr_it->second->index);
+}
+
+glm::quat
+SkinnedMesh::node_animated_rotation(const std::string &node_name) const {
+  auto node_ptr_it = m_transformation_tree->nodes_index.find(node_name);
+  assert(node_ptr_it != m_transformation_tree->nodes_index.end() &&
+         "node name valid");
+
+  ChannelSample sample;
+  get_current_local_sample(node_ptr_it->second->index, sample);
+  return sample.rotation;
 }
 
 void SkinnedMesh::render(Shader &shader, const Camera &camera,
@@ -495,13 +1144,15 @@ void SkinnedMesh::render(Shader &shader, const Camera &camera,
   // basic rendering
   shader.activate();
   // set camera position and matrix
-  shader.set_uniform("camPos", camera.position());
-  shader.set_uniform("camMatrix", camera.matrix());
+  shader.set_uniform(CAM_POS_UNIFORM, camera.position());
+  shader.set_uniform(CAM_MATRIX_UNIFORM, camera.matrix());
   // set light position and color
-  shader.set_uniform("lightPos", light.position());
-  shader.set_uniform("lightColor", light.color());
+  shader.set_uniform(LIGHT_POS_UNIFORM, light.position());
+  shader.set_uniform(LIGHT_COLOR_UNIFORM, light.color());
   // set bones transformations
   set_bones_transformation_uniforms(shader);
+  // other meshes may have changed the bindings since the last render call
+  m_material_state.reset();
 
   // render all
   for (unsigned int id = 0; id < m_render_objects->size(); ++id) {
@@ -517,13 +1168,15 @@ void SkinnedMesh::render(Shader &shader, const Camera &camera,
   // basic rendering
   shader.activate();
   // set camera position and matrix
-  shader.set_uniform("camPos", camera.position());
-  shader.set_uniform("camMatrix", camera.matrix());
+  shader.set_uniform(CAM_POS_UNIFORM, camera.position());
+  shader.set_uniform(CAM_MATRIX_UNIFORM, camera.matrix());
   // set light position and color
-  shader.set_uniform("lightPos", light.position());
-  shader.set_uniform("lightColor", light.color());
+  shader.set_uniform(LIGHT_POS_UNIFORM, light.position());
+  shader.set_uniform(LIGHT_COLOR_UNIFORM, light.color());
   // set bones transformations
   set_bones_transformation_uniforms(shader);
+  // other meshes may have changed the bindings since the last render call
+  m_material_state.reset();
 
   if (!exclude) {
     // render only given objects
@@ -557,6 +1210,69 @@ void SkinnedMesh::render_object(Shader &shader, unsigned int object_id) const {
   }
 }
 
+void SkinnedMesh::submit(RenderQueue &queue, RenderPass pass, Shader &shader,
+                         const Camera &camera,
+                         const glm::mat4 &transformation) const {
+  unsigned int instance = queue.add_instance(*this, transformation);
+  for (unsigned int id = 0; id < m_render_objects->size(); ++id) {
+    submit_object(queue, pass, shader, camera, transformation, instance, id);
+  }
+}
+
+void SkinnedMesh::submit(RenderQueue &queue, RenderPass pass, Shader &shader,
+                         const Camera &camera, const glm::mat4 &transformation,
+                         const std::vector<unsigned int> &render_object_ids,
+                         bool exclude) const {
+  unsigned int instance = queue.add_instance(*this, transformation);
+  if (!exclude) {
+    // submit only given objects
+    for (unsigned int id : render_object_ids) {
+      submit_object(queue, pass, shader, camera, transformation, instance, id);
+    }
+  } else {
+    // submit everything but given objects
+    // assumption is that render_object_ids is sorted
+    int current_to_exclude = 0;
+    for (unsigned int id = 0; id < m_render_objects->size(); ++id) {
+      if (current_to_exclude < render_object_ids.size() &&
+          render_object_ids[current_to_exclude] == id) {
+        ++current_to_exclude;
+        continue;
+      }
+
+      submit_object(queue, pass, shader, camera, transformation, instance, id);
+    }
+  }
+}
+
+void SkinnedMesh::submit_object(RenderQueue &queue, RenderPass pass,
+                                Shader &shader, const Camera &camera,
+                                const glm::mat4 &transformation,
+                                unsigned int instance,
+                                unsigned int object_id) const {
+  const auto *node = (*m_render_objects)[object_id];
+  assert(!node->meshes.empty() && "render object has meshes");
+  const glm::mat4 &node_transformation =
+      get_node_transformation(node).global_transformation;
+  // distance of the object's origin is good enough to order the objects
+  glm::vec3 position = transformation * node_transformation[3];
+  float depth = glm::length(position - camera.position());
+
+  for (unsigned int mesh_id : node->meshes) {
+    const auto &mesh_entry = (*m_entries)[mesh_id];
+    unsigned int material_id =
+        m_material_buffer->material_id(mesh_entry.m_material_index);
+    queue.submit({RenderQueue::make_key(pass, shader, material_id,
+                                        mesh_entry.m_vao, depth),
+                  &shader, mesh_entry.m_vao, instance, mesh_id,
+                  &node_transformation});
+  }
+}
+
+void SkinnedMesh::bind_instance(Shader &shader) const {
+  set_bones_transformation_uniforms(shader);
+}
+
 void SkinnedMesh::render_mesh(Shader &shader, unsigned int mesh_id,
                               const glm::mat4 &transformation) const {
   // basic rendering
@@ -565,34 +1281,56 @@ void SkinnedMesh::render_mesh(Shader &shader, unsigned int mesh_id,
   // bind
   glBindVertexArray(mesh_entry.m_vao);
 
+  draw_mesh(shader, mesh_id, transformation, m_material_state);
+
+  // unbind
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void SkinnedMesh::draw_mesh(Shader &shader, unsigned int mesh_id,
+                            const glm::mat4 &transformation,
+                            MaterialState &material_state) const {
+  auto const &mesh_entry = (*m_entries)[mesh_id];
+
   assert(mesh_entry.m_material_index < m_materials->size());
-  (*m_materials)[mesh_entry.m_material_index].set_slots(shader, "diffuse");
-  (*m_materials)[mesh_entry.m_material_index].set_uv_transformations(
-      shader, "uv_transformation");
-  (*m_materials)[mesh_entry.m_material_index].bind();
+  material_state.bind(*m_material_buffer, mesh_entry.m_material_index,
+                      (*m_materials)[mesh_entry.m_material_index]);
 
   // set transformation
-  if (mesh_entry.m_has_bones) {
-    // model transformation is already included in bones transformations,
-    // so there is no need to include it twice - set identity matrix for
-    // model
-    glUniformMatrix4fv(glGetUniformLocation(shader.id(), "model"), 1, GL_FALSE,
-                       glm::value_ptr(glm::mat4(1.0f)));
-  } else {
-    // there are no bones, use model transformation
-    glUniformMatrix4fv(glGetUniformLocation(shader.id(), "model"), 1, GL_FALSE,
-                       glm::value_ptr(transformation));
-  }
+  shader.set_uniform(MODEL_UNIFORM,
+                     get_model_transformation(mesh_id, transformation));
 
   // draw
   glDrawElements(GL_TRIANGLES, mesh_entry.m_indices_count, GL_UNSIGNED_INT, 0);
+}
 
-  // unbind
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void SkinnedMesh::draw_mesh_instanced(Shader &shader, unsigned int mesh_id,
+                                      unsigned int instance_count,
+                                      MaterialState &material_state) const {
+  auto const &mesh_entry = (*m_entries)[mesh_id];
+
+  assert(mesh_entry.m_material_index < m_materials->size());
+  material_state.bind(*m_material_buffer, mesh_entry.m_material_index,
+                      (*m_materials)[mesh_entry.m_material_index]);
 
-  (*m_materials)[mesh_entry.m_material_index].unbind();
+  // model transformations are part of the per instance data
+  glDrawElementsInstanced(GL_TRIANGLES, mesh_entry.m_indices_count,
+                          GL_UNSIGNED_INT, 0, instance_count);
+}
+
+glm::mat4
+SkinnedMesh::get_model_transformation(unsigned int mesh_id,
+                                      const glm::mat4 &transformation) const {
+  if ((*m_entries)[mesh_id].m_has_bones) {
+    // model transformation is already included in bones transformations,
+    // so there is no need to include it twice - use identity matrix for
+    // model
+    return glm::mat4(1.0f);
+  }
+  // there are no bones, use model transformation
+  return transformation;
 }
 
 void SkinnedMesh::render_to_texture(Shader &shader,
@@ -601,16 +1339,18 @@ void SkinnedMesh::render_to_texture(Shader &shader,
   // each mesh entry and its triangles
   shader.activate();
   // set camera matrix
-  shader.set_uniform("camMatrix", camera.matrix());
+  shader.set_uniform(CAM_MATRIX_UNIFORM, camera.matrix());
   // set bones transformations
   set_bones_transformation_uniforms(shader);
+  // other meshes may have changed the bindings since the last render call
+  m_material_state.reset();
 
   // each triangle that will be rendered for this entry will have gDrawIndex
   // set to mesh entry index, triangles indices will be set automatically in
   // shader
 
   for (unsigned int id = 0; id < m_render_objects->size(); ++id) {
-    shader.set_uniform("gDrawIndex", id);
+    shader.set_uniform(DRAW_INDEX_UNIFORM, id);
     assert(!(*m_render_objects)[id]->meshes.empty() &&
            "render object has meshes");
     for (unsigned int mesh_id : (*m_render_objects)[id]->meshes) {
@@ -628,12 +1368,14 @@ void SkinnedMesh::render_to_texture(
   // each mesh entry and its triangles
   shader.activate();
   // set camera matrix
-  shader.set_uniform("camMatrix", camera.matrix());
+  shader.set_uniform(CAM_MATRIX_UNIFORM, camera.matrix());
   // set bones transformations
   set_bones_transformation_uniforms(shader);
+  // other meshes may have changed the bindings since the last render call
+  m_material_state.reset();
 
   for (unsigned int id : ids_to_render) {
-    shader.set_uniform("gDrawIndex", id);
+    shader.set_uniform(DRAW_INDEX_UNIFORM, id);
     assert(!(*m_render_objects)[id]->meshes.empty() &&
            "render object has meshes");
     for (unsigned int mesh_id : (*m_render_objects)[id]->meshes) {
@@ -660,7 +1402,7 @@ void SkinnedMesh::render_primitive(Shader &shader, const Camera &camera,
 
   shader.activate();
   // set camera matrix
-  shader.set_uniform("camMatrix", camera.matrix());
+  shader.set_uniform(CAM_MATRIX_UNIFORM, camera.matrix());
   // set bones transformations
   set_bones_transformation_uniforms(shader);
 
@@ -676,14 +1418,12 @@ void SkinnedMesh::render_primitive(Shader &shader, const Camera &camera,
     // model transformation is already included in bones transformations,
     // so there is no need to include it twice - set identity matrix for
     // model
-    glUniformMatrix4fv(glGetUniformLocation(shader.id(), "model"), 1, GL_FALSE,
-                       glm::value_ptr(glm::mat4(1.0f)));
+    shader.set_uniform(MODEL_UNIFORM, glm::mat4(1.0f));
   } else {
     // there are no bones, use model transformation
-    glUniformMatrix4fv(glGetUniformLocation(shader.id(), "model"), 1, GL_FALSE,
-                       glm::value_ptr(get_node_transformation(
+    shader.set_uniform(MODEL_UNIFORM, get_node_transformation(
                                           (*m_render_objects)[object_index])
-                                          .global_transformation));
+                                          .global_transformation);
   }
 
   // draw
@@ -698,11 +1438,43 @@ void SkinnedMesh::render_primitive(Shader &shader, const Camera &camera,
 }
 
 void SkinnedMesh::set_bones_transformation_uniforms(Shader &shader) const {
-  // set all bones transformations
-  for (int i = 0; i < m_bone_transformations.size(); ++i) {
-    shader.set_uniform("gBones[" + std::to_string(i) + "]",
-                       m_bone_transformations[i]);
+  // only shaders with gUseDualQuaternions read the dual quaternions palette
+  bool dual_quaternions = m_skinning_mode == SkinningMode::DualQuaternion &&
+                          shader.has_uniform(USE_DUAL_QUATERNIONS_UNIFORM);
+  shader.set_uniform(USE_DUAL_QUATERNIONS_UNIFORM, dual_quaternions ? 1 : 0);
+  if (dual_quaternions) {
+    if (!m_bone_dual_quaternions_buffer.is_uploaded(m_bones_version)) {
+      std::vector<glm::mat2x4> dual_quaternions;
+      dual_quaternions.reserve(m_bone_transformations.size());
+      for (const auto &bone_transformation : m_bone_transformations) {
+        dual_quaternions.push_back(utility::convert_to_dual_quaternion(
+            utility::get_affine_matrix(bone_transformation)));
+      }
+      m_bone_dual_quaternions_buffer.upload(
+          dual_quaternions.data(),
+          dual_quaternions.size() * sizeof(glm::mat2x4), m_bones_version);
+    }
+    m_bone_dual_quaternions_buffer.bind(BONE_DUAL_QUATERNIONS_BINDING);
+    return;
+  }
+
+  // whole palette is uploaded once per pose, other draw calls and passes
+  // with the same pose only bind it
+  if (!m_bone_matrices_buffer.is_uploaded(m_bones_version)) {
+    if (m_bone_transformations.empty()) {
+      // meshes without bones get one identity bone, so the buffer the
+      // shader reads from is never empty
+      glm::mat3x4 identity(1.0f);
+      m_bone_matrices_buffer.upload(&identity, sizeof(glm::mat3x4),
+                                    m_bones_version);
+    } else {
+      m_bone_matrices_buffer.upload(m_bone_transformations.data(),
+                                    m_bone_transformations.size() *
+                                        sizeof(glm::mat3x4),
+                                    m_bones_version);
+    }
   }
+  m_bone_matrices_buffer.bind(BONE_MATRICES_BINDING);
 }
 
 std::optional<unsigned int>
@@ -727,7 +1499,7 @@ unsigned int SkinnedMesh::add_bone(const aiBone *bone) {
   m_bone_index->emplace(bone->mName.data, new_bone_index);
   m_bones->push_back(
       {bone->mName.data, utility::convert_to_glm_mat4(bone->mOffsetMatrix)});
-  m_bone_transformations.push_back(glm::mat4(1.0f));
+  m_bone_transformations.push_back(glm::mat3x4(1.0f));
   return new_bone_index;
 }
 
@@ -755,7 +1527,9 @@ SkinnedMesh::get_bvh(const glm::mat4 &user_transformation, bool packed) const {
                                      m_mesh_bounding_boxes->size());
   for (const auto &bounding_box_pair : *m_bones_bounding_boxes) {
     transformed_bounding_boxes.emplace_back(bounding_box_pair.second.transform(
-        user_transformation * m_bone_transformations[bounding_box_pair.first]));
+        user_transformation *
+        utility::get_affine_matrix(
+            m_bone_transformations[bounding_box_pair.first])));
   }
 
   for (const auto &render_object : *m_render_objects) {
@@ -776,6 +1550,116 @@ SkinnedMesh::get_bvh(const glm::mat4 &user_transformation, bool packed) const {
       BoundingBox::bounding_aabb(transformed_bounding_boxes));
 }
 
+BoundingBox
+SkinnedMesh::get_bounds(const glm::mat4 &user_transformation) const {
+  // animation bounds don't contain pose layers
+  bool layered = std::any_of(m_pose_layers.begin(), m_pose_layers.end(),
+                             &SkinnedMesh::is_active);
+  if (layered || !m_current_bounds || !m_current_bounds_valid ||
+      m_current_bounds->frames.empty()) {
+    return get_bvh(user_transformation, true)->volume;
+  }
+
+  unsigned int last_frame = m_current_bounds->frames.size() - 1;
+  unsigned int frame = 0;
+  if (m_current_bounds->frame_duration > 0.0f) {
+    frame = std::min(static_cast<unsigned int>(
+                         m_current_bounds_time /
+                         m_current_bounds->frame_duration),
+                     last_frame);
+  }
+
+  return BoundingBox::bounding_aabb(
+      {BoundingBox(m_current_bounds->frames[frame])
+           .transform(user_transformation)});
+}
+
+void SkinnedMesh::init_animation_bounds() {
+  m_animation_bounds->reserve(m_animations->size());
+
+  // animations are evaluated on this copy's pose, which is restored afterwards
+  auto node_transformations = m_node_transformations;
+  auto bone_transformations = m_bone_transformations;
+  auto channel_cursors = m_channel_cursors;
+
+  for (const auto &animation : *m_animations) {
+    AnimationBounds animation_bounds;
+    unsigned int frame_count =
+        animation.m_duration > 0.0f
+            ? static_cast<unsigned int>(
+                  std::ceil(animation.m_duration * BOUNDS_SAMPLE_RATE /
+                            animation.m_ticks_per_second)) +
+                  1
+            : 1;
+    animation_bounds.frame_duration =
+        frame_count > 1 ? animation.m_duration / (frame_count - 1) : 0.0f;
+
+    // nodes that are not animated keep the pose from the loading
+    m_node_transformations = node_transformations;
+    animation_bounds.base_pose = get_base_pose_hash(animation);
+    std::vector<AABB> samples;
+    samples.reserve(frame_count);
+    for (unsigned int f = 0; f < frame_count; ++f) {
+      calculate_bones_transformations(
+          animation, std::min(f * animation_bounds.frame_duration,
+                              animation.m_duration));
+      samples.push_back(get_pose_aabb());
+    }
+
+    // pose between two samples is approximated by their union
+    animation_bounds.frames.reserve(frame_count);
+    for (unsigned int f = 0; f < frame_count; ++f) {
+      AABB a = samples[f];
+      if (f + 1 < frame_count) {
+        a.update(samples[f + 1]);
+      }
+      if (!a.valid()) {
+        animation_bounds.frames.push_back(a);
+        continue;
+      }
+
+      // bones rotating between two samples bulge out of the union
+      float padding_x = (a.max_x - a.min_x) * BOUNDS_PADDING;
+      float padding_y = (a.max_y - a.min_y) * BOUNDS_PADDING;
+      float padding_z = (a.max_z - a.min_z) * BOUNDS_PADDING;
+      animation_bounds.frames.emplace_back(
+          a.min_x - padding_x, a.max_x + padding_x, a.min_y - padding_y,
+          a.max_y + padding_y, a.min_z - padding_z, a.max_z + padding_z);
+    }
+
+    m_animation_bounds->push_back(std::move(animation_bounds));
+  }
+
+  m_node_transformations = std::move(node_transformations);
+  m_bone_transformations = std::move(bone_transformations);
+  m_channel_cursors = std::move(channel_cursors);
+}
+
+AABB SkinnedMesh::get_pose_aabb() const {
+  AABB aabb;
+  for (const auto &bounding_box_pair : *m_bones_bounding_boxes) {
+    aabb.update(bounding_box_pair.second
+                    .transform(utility::get_affine_matrix(
+                        m_bone_transformations[bounding_box_pair.first]))
+                    .aabb());
+  }
+
+  for (const auto &render_object : *m_render_objects) {
+    for (unsigned int mesh_index : render_object->meshes) {
+      if (!(*m_entries)[mesh_index].m_has_bones) {
+        auto mesh_box_it = m_mesh_bounding_boxes->find(mesh_index);
+        assert(mesh_box_it != m_mesh_bounding_boxes->end() && "mesh box found");
+        aabb.update(mesh_box_it->second
+                        .transform(get_node_transformation(render_object)
+                                       .global_transformation)
+                        .aabb());
+      }
+    }
+  }
+
+  return aabb;
+}
+
 std::unique_ptr<BVHNode<BoundingBox>>
 SkinnedMesh::get_bvh(const TransformationNode &node,
                      const glm::mat4 &transformation) const {
@@ -824,57 +1708,70 @@ SkinnedMesh::get_bvh(const TransformationNode &node,
 void SkinnedMesh::create_transition_animation(
     const std::string &position_name, float duration,
     const std::string &bone_to_ignore) {
-  m_transitions_animations.clear();
-  std::vector<Channel> channels;
-  std::unordered_map<std::string, int> channels_map;
-
-  auto position_it = m_positions->find(position_name);
-  if (position_it == m_positions->end()) {
-    position_it = m_animations->find(position_name);
-    assert(position_it != m_animations->end() && "valid position name");
+  auto position_it = m_position_index->find(position_name);
+  if (position_it != m_position_index->end()) {
+    create_transition_animation((*m_positions)[position_it->second], duration,
+                                bone_to_ignore);
+  } else {
+    create_transition_animation(
+        (*m_animations)[get_clip_id(position_name).index], duration,
+        bone_to_ignore);
   }
+}
 
-  for (const auto &node_transformations : m_node_transformations) {
-    const std::string &name = node_transformations.first->name;
-    if (name == bone_to_ignore) {
-      continue;
-    }
-
-    const TransformationNodeMutable &transformations =
-        node_transformations.second;
-
-    std::vector<KeyPosition> positions;
-    positions.push_back({transformations.local_translation, 0});
-    std::vector<KeyRotation> rotations;
-    rotations.push_back({transformations.local_rotation, 0});
-    std::vector<KeyScale> scaling;
-    scaling.push_back({transformations.local_scaling, 0});
-
-    Channel *channel = position_it->second.get_channel(name);
-    if (channel) {
-      const auto &position_channel = channel->positions_channel();
-      const auto &scaling_channel = channel->scales_channel();
-      const auto &rotation_channel = channel->rotations_channel();
-
-      if (!position_channel.empty()) {
-        positions.push_back({position_channel[0].position, duration});
-      }
+void SkinnedMesh::create_transition_animation(
+    PositionId position_id, float duration,
+    const std::string &bone_to_ignore) {
+  assert(position_id.index < m_positions->size() && "position id is valid");
+  create_transition_animation((*m_positions)[position_id.index], duration,
+                              bone_to_ignore);
+}
 
-      if (!scaling_channel.empty()) {
-        scaling.push_back({scaling_channel[0].scale, duration});
-      }
+void SkinnedMesh::create_transition_animation(
+    const Animation &target, float duration,
+    const std::string &bone_to_ignore) {
+  // transition starts from the current local transformations
+  evaluate_deferred_pose();
+  apply_pending_locals();
+
+  m_transition_target = &target;
+  m_transition_duration = duration;
+  m_transition_ignored_node = -1;
+  if (!bone_to_ignore.empty()) {
+    auto node_ptr_it = m_transformation_tree->nodes_index.find(bone_to_ignore);
+    assert(node_ptr_it != m_transformation_tree->nodes_index.end() &&
+           "node name valid");
+    m_transition_ignored_node = node_ptr_it->second->index;
+  }
 
-      if (!rotation_channel.empty()) {
-        rotations.push_back({rotation_channel[0].orientation, duration});
-      }
+  // start and end poses are stored in buffers allocated once, so creating a
+  // transition doesn't allocate memory
+  const auto &nodes = m_transformation_tree->nodes;
+  for (unsigned int i = 0; i < nodes.size(); ++i) {
+    auto &start = m_transition_start_pose[i];
+    get_current_local_sample(i, start);
+    if (static_cast<int>(i) != m_transition_ignored_node) {
+      // transition starts from the displayed pose, so pose layers of the
+      // transitioned nodes are merged into the start pose
+      blend_pose_layers(i, start);
     }
 
-    channels_map.emplace(name, channels.size());
-    channels.emplace_back(name, positions, rotations, scaling);
+    // nodes not animated by the target stay in their current pose
+    // keyframes of resampled channels are released, so the target is
+    // sampled at its start instead of reading the first keyframes
+    ChannelCursor cursor;
+    if (!m_transition_target->sample(i, 0.0f, m_transition_end_pose[i],
+                                     cursor)) {
+      m_transition_end_pose[i] = start;
+    }
   }
 
-  m_transitions_animations.emplace_back("transition", std::move(channels),
-                                        std::move(channels_map), duration, 1);
+  for (auto &layer : m_pose_layers) {
+    if (static_cast<int>(layer.node_index) != m_transition_ignored_node) {
+      layer.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+      layer.weight = 0.0f;
+    }
+  }
 }
 
 // MeshEntry
@@ -16,6 +16,7 @@
 
 #include <array>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
@@ -24,10 +25,13 @@
 
 #include "aabb.h"
 #include "animation.h"
+#include "bone_buffer.h"
 #include "bounding_box.h"
 #include "camera.h"
 #include "light.h"
 #include "material.h"
+#include "pose_cache.h"
+#include "render_queue.h"
 #include "shader.h"
 #include "texture.h"
 #include "utility.h"
@@ -94,6 +98,8 @@ struct TransformationNode {
   std::string name;
   std::vector<unsigned int> meshes;
   std::vector<std::unique_ptr<TransformationNode>> children;
+  // node index in depth-first order (index in TransformationTree::nodes)
+  unsigned int index = 0;
 };
 
 struct TransformationNodeMutable {
@@ -110,28 +116,28 @@ struct TransformationTree {
 
   TransformationTree(
       const aiNode *node,
-      std::unordered_map<const TransformationNode *, TransformationNodeMutable>
-          &transformation_map)
-      : root_node(init_nodes(node, transformation_map)) {}
+      std::vector<TransformationNodeMutable> &node_transformations)
+      : root_node(nullptr) {
+    root_node = init_nodes(node, -1, node_transformations);
+  }
 
-  std::unique_ptr<TransformationNode> init_nodes(
-      const aiNode *node,
-      std::unordered_map<const TransformationNode *, TransformationNodeMutable>
-          &transformation_map) {
+  std::unique_ptr<TransformationNode>
+  init_nodes(const aiNode *node, int parent_index,
+             std::vector<TransformationNodeMutable> &node_transformations) {
     assert(node && "node not null");
 
-    std::vector<unsigned int> meshes;
+    auto node_uptr = std::make_unique<TransformationNode>();
+    node_uptr->name = node->mName.data;
     for (int i = 0; i < node->mNumMeshes; ++i) {
-      meshes.push_back(node->mMeshes[i]);
-    }
-
-    std::vector<std::unique_ptr<TransformationNode>> children;
-    for (int i = 0; i < node->mNumChildren; i++) {
-      children.emplace_back(init_nodes(node->mChildren[i], transformation_map));
+      node_uptr->meshes.push_back(node->mMeshes[i]);
     }
 
-    auto node_uptr = std::make_unique<TransformationNode>(TransformationNode{
-        node->mName.data, std::move(meshes), std::move(children)});
+    // visit nodes in depth-first order, so that every parent is placed before
+    // its children and the whole tree can be updated in one linear pass
+    node_uptr->index = nodes.size();
+    nodes.push_back(node_uptr.get());
+    parents.push_back(parent_index);
+    subtree_ends.push_back(0);
 
     aiVector3t<float> ai_scaling;
     aiQuaterniont<float> ai_rotation;
@@ -142,35 +148,100 @@ struct TransformationTree {
     glm::quat rotation(ai_rotation.w, ai_rotation.x, ai_rotation.y,
                        ai_rotation.z);
 
-    // auto a = glm::translate(glm::mat4(1.0f), position);
-    // auto b = glm::scale(glm::mat4(1.0f), scaling);
-    // auto c = glm::mat4(rotation);
-    // auto x = a * c * b;
-    // std::cout << "--------------" << std::endl;
-    // utility::print_glm_mat4(x);
-    // std::cout << std::endl;
-    // utility::print_glm_mat4(
-    //     utility::convert_to_glm_mat4(node->mTransformation));
-    // std::cout << "--------------" << std::endl;
-
-    transformation_map.emplace(
-        node_uptr.get(), TransformationNodeMutable{scaling, rotation, position,
-                                                   utility::convert_to_glm_mat4(
-                                                       node->mTransformation),
-                                                   glm::mat4(1.0f)});
+    // node's transformations are stored at node's index
+    node_transformations.push_back(TransformationNodeMutable{
+        scaling, rotation, position,
+        utility::convert_to_glm_mat4(node->mTransformation), glm::mat4(1.0f)});
 
     nodes_index[node_uptr->name] = node_uptr.get();
+
+    for (int i = 0; i < node->mNumChildren; i++) {
+      node_uptr->children.emplace_back(init_nodes(
+          node->mChildren[i], node_uptr->index, node_transformations));
+    }
+
+    subtree_ends[node_uptr->index] = nodes.size();
     return node_uptr;
   }
 
   // node name -> node's pointer
   std::unordered_map<std::string, TransformationNode *> nodes_index;
   std::unique_ptr<TransformationNode> root_node;
+
+  // node index -> node's pointer (nodes are in depth-first order)
+  std::vector<const TransformationNode *> nodes;
+  // node index -> parent's node index (-1 for the root node)
+  std::vector<int> parents;
+  // node index -> index after the last node in node's subtree, node's subtree
+  // is [node index, subtree end)
+  std::vector<unsigned int> subtree_ends;
+};
+
+// how pose layer's rotation is combined with node's animated rotation
+enum class PoseLayerMode {
+  // layer's rotation is applied after the animated rotation
+  Additive,
+  // layer's rotation replaces the animated rotation
+  Override
+};
+
+// procedural rotation of a node (and its subtree) applied on top of the
+// animated pose
+struct PoseLayer {
+  unsigned int node_index;
+  PoseLayerMode mode;
+  glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  // 0 - layer has no effect, 1 - rotation is fully applied
+  float weight = 1.0f;
+};
+
+// conservative bounds of an animation precomputed at load in the space of
+// bones final transformations
+// animation is sampled on the base pose from the loading (nodes it doesn't
+// animate keep their loaded transformations), so the bounds are used only
+// while the base pose is the same, other base poses (left by other
+// animations, transitions or scale_node) use exact bounds
+struct AnimationBounds {
+  // time between two sampled frames in ticks
+  float frame_duration = 0.0f;
+  // box f contains the poses sampled at frames f and f + 1 padded by a
+  // fraction of its size, so poses between the samples are contained too
+  std::vector<AABB> frames;
+  // hash of the base pose the animation was sampled on
+  std::size_t base_pose = 0;
+};
+
+// how bones final transformations are blended in the vertex shader
+enum class SkinningMode {
+  // weighted sum of bone matrices
+  Matrix,
+  // normalized weighted sum of bone dual quaternions, bones have to be rigid
+  // (their scaling is ignored)
+  DualQuaternion
+};
+
+// handle of an animation resolved once from its name
+// index of the animation in skinned mesh animations
+struct ClipId {
+  unsigned int index;
+
+  bool operator==(const ClipId &other) const { return index == other.index; }
+};
+
+// handle of a position resolved once from its name
+// index of the position in skinned mesh positions
+struct PositionId {
+  unsigned int index;
 };
 
 class SkinnedMesh {
 public:
-  SkinnedMesh(const std::string &filename);
+  // clip of the current transition created by create_transition_animation
+  static constexpr ClipId TRANSITION_CLIP{
+      std::numeric_limits<unsigned int>::max()};
+
+  SkinnedMesh(const std::string &filename,
+              const AnimationImportSettings &animation_settings = {});
 
   // basic rendering
   void render(Shader &shader, const Camera &camera, const Light &light) const;
@@ -180,6 +251,40 @@ public:
               const std::vector<unsigned int> &render_object_ids,
               bool exclude) const;
 
+  // add draw items of all the objects to the queue instead of rendering them,
+  // transformation is the one set for the shader by the caller of render
+  void submit(RenderQueue &queue, RenderPass pass, Shader &shader,
+              const Camera &camera, const glm::mat4 &transformation) const;
+
+  // add draw items of specific objects to the queue
+  void submit(RenderQueue &queue, RenderPass pass, Shader &shader,
+              const Camera &camera, const glm::mat4 &transformation,
+              const std::vector<unsigned int> &render_object_ids,
+              bool exclude) const;
+
+  // set uniforms shared by all the draw items of this copy (bones)
+  void bind_instance(Shader &shader) const;
+
+  // draw one mesh entry, vao of the entry has to be bound
+  void draw_mesh(Shader &shader, unsigned int mesh_id,
+                 const glm::mat4 &transformation,
+                 MaterialState &material_state) const;
+
+  // draw one mesh entry for the given number of instances, vao of the entry
+  // and per instance data have to be bound
+  void draw_mesh_instanced(Shader &shader, unsigned int mesh_id,
+                           unsigned int instance_count,
+                           MaterialState &material_state) const;
+
+  // return model transformation of the mesh entry, transformation is the
+  // global transformation of the mesh node
+  glm::mat4 get_model_transformation(unsigned int mesh_id,
+                                     const glm::mat4 &transformation) const;
+
+  const std::vector<glm::mat3x4> &bone_transformations() const {
+    return m_bone_transformations;
+  }
+
   // rendering to texture for mouse picking
   void render_to_texture(Shader &shader, const Camera &camera) const;
 
@@ -200,48 +305,112 @@ public:
   std::unique_ptr<BVHNode<BoundingBox>>
   get_bvh(const glm::mat4 &user_transformation = glm::mat4(1.0f),
           bool packed = false) const;
+  // return aabb of the current pose looked up in the precomputed animation
+  // bounds, it contains the packed bvh and is computed the same way when the
+  // pose is not a plain animation pose
+  BoundingBox get_bounds(const glm::mat4 &user_transformation) const;
+
+  // return handle of the animation with the given name, "transition" is
+  // the current transition
+  ClipId get_clip_id(const std::string &animation_name) const;
+  // return handle of the position with the given name
+  PositionId get_position_id(const std::string &position_name) const;
 
   // return true if animation is finished and return global transformation
+  // if defer_pose is true only global transformation is calculated and the
+  // pose is evaluated later when it's needed
+  std::pair<bool, glm::mat4> get_bones_for_animation(ClipId clip_id,
+                                                     float time,
+                                                     float speed_factor = 1.0f,
+                                                     bool defer_pose = false);
+  // resolve animation name on every call, used for setup
   std::pair<bool, glm::mat4>
   get_bones_for_animation(const std::string &animation_name, float time,
                           float speed_factor = 1.0f);
 
   // return global transformation
+  glm::mat4 get_bones_for_position(PositionId position_id);
+  // resolve position name on every call, used for setup
   glm::mat4 get_bones_for_position(const std::string &position_name);
 
-  glm::mat4 get_final_global_transformation_for_animation(
-      const std::string &animation_name);
+  // return root motion of the animation at the given time without evaluating
+  // the pose
+  RootMotion get_root_motion(ClipId clip_id, float time,
+                             float speed_factor = 1.0f) const;
+
+  glm::mat4 node_global_transformation(const std::string &node_name) const;
 
-  const glm::mat4 &
-  node_global_transformation(const std::string &node_name) const;
+  glm::mat4 node_local_transformation(const std::string &node_name) const;
+  // return rotation of the node in its parent space set by the animations,
+  // pose layers are not included
+  glm::quat node_animated_rotation(const std::string &node_name) const;
 
-  const glm::mat4 &
-  node_local_transformation(const std::string &node_name) const;
+  // set nodes whose global transformations are queried while the pose is
+  // deferred, only their ancestors are evaluated for the deferred pose
+  void set_socket_nodes(const std::vector<std::string> &node_names);
+  // evaluate the deferred pose now, so bones transformations match the
+  // current animation time
+  void evaluate_pose();
 
   void scale_node(const std::string &node_name, const glm::vec3 &scaling);
 
-  void rotate_bone(const std::string &bone_name, const glm::quat &q);
+  void set_skinning_mode(SkinningMode skinning_mode);
+  SkinningMode skinning_mode() const { return m_skinning_mode; }
+
+  // number of nodes whose global transformations were recomputed by all the
+  // skinned meshes since the last reset
+  static unsigned int recomputed_nodes_count();
+  static void reset_recomputed_nodes_count();
+
+  // add pose layer for the given node and return its index
+  // layers are added in depth-first order of their nodes
+  unsigned int add_pose_layer(const std::string &node_name,
+                              PoseLayerMode mode);
+  // return index of the pose layer of the given node
+  unsigned int get_pose_layer(const std::string &node_name) const;
+  void set_pose_layer(unsigned int layer_index, const glm::quat &rotation,
+                      float weight = 1.0f);
 
   void create_transition_animation(const std::string &position_name,
                                    float duration,
                                    const std::string &bone_to_ignore = "");
+  void create_transition_animation(PositionId position_id, float duration,
+                                   const std::string &bone_to_ignore = "");
 
 private:
-  void init_from_scene(const aiScene *scene, const std::string &filename);
+  // create transition from the current pose to the start of the target
+  void create_transition_animation(const Animation &target, float duration,
+                                   const std::string &bone_to_ignore);
+
+  void init_from_scene(const aiScene *scene, const std::string &filename,
+                       const AnimationImportSettings &animation_settings);
   void init_mesh_entries(const aiScene *scene);
   void init_mesh_entry(const aiMesh *mesh);
   void init_materials(const aiScene *scene, const std::string &filename);
-  void init_animations(const aiScene *scene);
+  void init_animations(const aiScene *scene,
+                       const AnimationImportSettings &settings);
   // init m_render_objects and m_nodes_to_render_object_index
   void init_render_objects(const std::unique_ptr<TransformationNode> &node);
 
-  // update bones and nodes global transformations
-  void update_global_transformations(
-      const std::unique_ptr<TransformationNode> &node,
-      const glm::mat4 &parent_transform = glm::mat4(1.0f));
+  // init m_node_bones after all the bones are added
+  void init_node_bones();
+
+  // mark node's local transformation as changed, its subtree is recomputed by
+  // the next update_global_transformations
+  void mark_dirty(unsigned int node_index);
+  // update bones and nodes global transformations of dirty subtrees
+  void update_global_transformations();
+  // update global transformations of the node's subtree and mark it clean
+  void update_global_transformations(unsigned int node_index);
+  // mark all the nodes clean after a pass that recomputed the whole tree
+  void clear_dirty_nodes();
 
   // fill m_bones_bounding_boxes with bones aabb
   void set_bones_bounding_boxes();
+  // fill m_animation_bounds by sampling all the animations
+  void init_animation_bounds();
+  // return aabb of the current pose without user transformation
+  AABB get_pose_aabb() const;
   void update_bones_aabb(const std::vector<MeshVertex> &vertices);
   // fill m_mesh_bounding_boxes with mesh aabb
   void add_mesh_aabb(const std::vector<MeshVertex> &vertices);
@@ -255,13 +424,87 @@ private:
   void set_bones_transformation_uniforms(Shader &shader) const;
 
   // return root global transform
-  glm::mat4 calculate_bones_transformations(Animation &animation,
-                                            float animation_time,
-                                            TransformationNode &node,
-                                            const glm::mat4 &parent_transform);
+  glm::mat4 calculate_bones_transformations(const Animation &animation,
+                                            float animation_time);
+
+  // return root global transform, pose is evaluated with the pose cache if
+  // the animation can be baked
+  glm::mat4 evaluate_bones_transformations(const Animation &animation,
+                                           float animation_time);
+
+  // return root global transform sampled from the animation
+  glm::mat4 get_root_transformation(const Animation &animation,
+                                    float animation_time);
+
+  // return true if transition is finished and return root global transform
+  std::pair<bool, glm::mat4> update_transition(float time, float speed_factor);
+  // blend transition start and end poses with the given weight of the end
+  // pose, return root global transform
+  glm::mat4 calculate_transition_transformations(float weight);
+
+  // ---------- deferred pose -----------------
+  // remember animation time and return root global transform, pose is not
+  // evaluated until evaluate_deferred_pose is called
+  glm::mat4 defer_bones_transformations(const Animation &animation,
+                                        float animation_time);
+  // evaluate pose of the deferred animation, called before the pose is used
+  // or changed
+  void evaluate_deferred_pose();
+  // set sample to the current local transformation of the node including the
+  // deferred and baked animations that are not applied yet, pose layers are
+  // not included
+  void get_current_local_sample(unsigned int node_index,
+                                ChannelSample &sample) const;
+  // return current local transformation of the node including pose layers
+  glm::mat4 get_current_local_transformation(unsigned int node_index) const;
+  // return current global transformation of the node, only socket nodes can
+  // be queried while the pose is deferred
+  glm::mat4 get_current_global_transformation(unsigned int node_index) const;
+  // update m_socket_transformations for the deferred pose
+  void evaluate_socket_nodes();
+  // ---------------------------------------------
+
+  // ---------- pose layers -----------------
+  // apply pose layers of the node to its local transformation sample
+  void blend_pose_layers(unsigned int node_index, ChannelSample &sample) const;
+  // apply active pose layers to the evaluated pose
+  void apply_pose_layers();
+  // update global transformations of node's subtree after its pose layers
+  // changed
+  void update_layered_node(unsigned int node_index);
+  // return true if the layer changes the pose
+  static bool is_active(const PoseLayer &layer);
+  // ---------------------------------------------
+
+  // ---------- baked pose cache -----------------
+  // return root global transform, use baked animation from the pose cache if
+  // it exists for the current base pose
+  glm::mat4 get_cached_bones_transformations(const Animation &animation,
+                                             float animation_time);
+  // evaluate animation at evenly spaced frames starting from this copy's pose
+  BakedAnimation bake_animation(const Animation &animation);
+  // set nodes global and bones final transformations from the baked frame
+  // nearest to the animation time, return animation time of that frame
+  float set_baked_pose(const BakedAnimation &baked_animation,
+                       float animation_time);
+  // set local transformations of the nodes animated by the baked animation,
+  // they are not set while the baked animation is used until they are needed
+  void apply_pending_locals();
+  // apply pending local transformations and stop using baked animation,
+  // called before the pose is changed without the pose cache
+  void invalidate_baked_pose();
+  // return hash of local transformations of the nodes that are not animated
+  // by the given animation
+  std::size_t get_base_pose_hash(const Animation &animation) const;
+  // ---------------------------------------------
 
   void render_object(Shader &shader, unsigned int object_id) const;
 
+  // add draw items of one render object to the queue
+  void submit_object(RenderQueue &queue, RenderPass pass, Shader &shader,
+                     const Camera &camera, const glm::mat4 &transformation,
+                     unsigned int instance, unsigned int object_id) const;
+
   // render one mesh entry
   void render_mesh(Shader &shader, unsigned int mesh_id,
                    const glm::mat4 &transformation) const;
@@ -313,6 +556,8 @@ private:
 
   // all materials
   std::shared_ptr<std::vector<Material>> m_materials;
+  // blocks of m_materials uploaded at load
+  std::shared_ptr<const MaterialBuffer> m_material_buffer;
   // texture name -> texture object
   std::shared_ptr<std::unordered_map<std::string, Texture>> m_textures;
 
@@ -321,6 +566,9 @@ private:
   // bone name -> bone index in m_bones
   std::shared_ptr<std::unordered_map<std::string, unsigned int>> m_bone_index;
 
+  // node index -> bone index in m_bones (-1 if node is not a bone)
+  std::shared_ptr<std::vector<int>> m_node_bones;
+
   // bone index -> bone bounding box
   std::shared_ptr<std::unordered_map<unsigned int, BoundingBox>>
       m_bones_bounding_boxes;
@@ -328,12 +576,20 @@ private:
   std::shared_ptr<std::unordered_map<unsigned int, BoundingBox>>
       m_mesh_bounding_boxes;
 
-  // animation name -> animation object
-  std::shared_ptr<std::unordered_map<std::string, Animation>> m_animations;
+  // clip id -> animation object
+  std::shared_ptr<std::vector<Animation>> m_animations;
+  // clip id -> bounds of the animation
+  std::shared_ptr<std::vector<AnimationBounds>> m_animation_bounds;
+  // animation name -> clip id index
+  std::shared_ptr<std::unordered_map<std::string, unsigned int>>
+      m_animation_index;
   // positions are represented as animations with duration 0
   // which means there is only one keyframe
-  // position name -> position object
-  std::shared_ptr<std::unordered_map<std::string, Animation>> m_positions;
+  // position id -> position object
+  std::shared_ptr<std::vector<Animation>> m_positions;
+  // position name -> position id index
+  std::shared_ptr<std::unordered_map<std::string, unsigned int>>
+      m_position_index;
 
   std::shared_ptr<TransformationTree> m_transformation_tree;
 
@@ -343,21 +599,100 @@ private:
   std::shared_ptr<std::unordered_map<const TransformationNode *, unsigned int>>
       m_nodes_to_render_object_index;
 
+  // baked animations (nullptr if animations are not baked)
+  std::shared_ptr<PoseCache> m_pose_cache;
+
+  // socket nodes and all their ancestors except the root in depth-first order
+  std::shared_ptr<const std::vector<unsigned int>> m_socket_nodes;
+  // node index -> index in m_socket_nodes (-1 if node is not in the list)
+  std::shared_ptr<const std::vector<int>> m_socket_indices;
+
   // --------- non shadered objects ------------------------
   // non shadered objects are unique for each
   // copy of the skinned mesh class
 
   // nodes global and local transformations
-  // node ptr -> node's transformations
-  std::unordered_map<const TransformationNode *, TransformationNodeMutable>
-      m_node_transformations;
+  // node index -> node's transformations
+  std::vector<TransformationNodeMutable> m_node_transformations;
 
   // bones final transformations
   // indices correspond to m_bones indices
   // final transformation transforms init local mesh coordinates to local
   // coordinates of transformed mesh
-  std::vector<glm::mat4> m_bone_transformations;
-  std::vector<Animation> m_transitions_animations;
+  // only the first three rows are kept, see utility::multiply_affine_rows
+  std::vector<glm::mat3x4> m_bone_transformations;
+
+  // node index -> keyframe indices found by the last sampling of node's
+  // channel, used to speed up keyframe lookup of the next frame
+  std::vector<ChannelCursor> m_channel_cursors;
+
+  // node index -> true if node's local transformation changed after the last
+  // pass that recomputed the node
+  // root's global transformation is always identity, root's local
+  // transformation is the transformation of the whole object and it's
+  // returned to the caller instead of being applied to the hierarchy
+  std::vector<bool> m_dirty_nodes;
+  // see recomputed_nodes_count
+  static unsigned int recomputed_nodes_counter;
+
+  // animation whose base pose was looked up in the pose cache last time
+  const Animation *m_pose_cache_animation;
+  // baked animation used for the current pose (nullptr if pose is evaluated)
+  std::shared_ptr<const BakedAnimation> m_baked_animation;
+  // animation time of the pose taken from m_baked_animation
+  float m_baked_time;
+  // true if nodes animated by m_pose_cache_animation don't have local
+  // transformations at m_baked_time set yet
+  bool m_pending_locals;
+
+  // animation whose pose is not evaluated yet (nullptr if pose is evaluated)
+  const Animation *m_deferred_animation;
+  // animation time of the deferred pose
+  float m_deferred_time;
+  // global transformations of m_socket_nodes for the deferred pose
+  std::vector<glm::mat4> m_socket_transformations;
+
+  // procedural rotations applied on top of the animated pose, sorted by node
+  // index
+  std::vector<PoseLayer> m_pose_layers;
+
+  // bounds of the animation of the current pose (nullptr if the pose is not
+  // a plain animation pose)
+  const AnimationBounds *m_current_bounds;
+  // false if the current base pose isn't the one m_current_bounds were
+  // sampled on
+  bool m_current_bounds_valid;
+  // animation time of the current pose in ticks
+  float m_current_bounds_time;
+
+  // how bones are uploaded to shaders that support dual quaternions, other
+  // shaders always get matrices
+  SkinningMode m_skinning_mode;
+
+  // material bound by the last draw call of the current render call
+  mutable MaterialState m_material_state;
+
+  // incremented whenever m_bone_transformations change
+  unsigned int m_bones_version;
+  // bones palettes uploaded for the shaders, matrices and dual quaternions
+  // are uploaded only when a shader uses them
+  mutable BoneBuffer m_bone_matrices_buffer;
+  mutable BoneBuffer m_bone_dual_quaternions_buffer;
+
+  // ---------- transition -----------------
+  // transition blends local transformations of all the nodes from the start
+  // pose to the first keyframes of the target animation or position
+  // node index -> local transformations when the transition was created
+  std::vector<ChannelSample> m_transition_start_pose;
+  // node index -> local transformations at the end of the transition
+  std::vector<ChannelSample> m_transition_end_pose;
+  // target animation or position (nullptr if no transition was created)
+  const Animation *m_transition_target;
+  // duration in seconds
+  float m_transition_duration;
+  // node index of the node that is not changed by the transition (-1 if all
+  // nodes are changed)
+  int m_transition_ignored_node;
 };
 
 #endif /*_SKINNED_MESH_H_ */
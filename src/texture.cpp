@@ -10,8 +10,7 @@ Texture::~Texture() {
   }
 }
 
-Texture::Texture(const char *image, TextureType type, GLuint slot)
-    : m_type(type), m_slot(slot) {
+Texture::Texture(const char *image, TextureType type) : m_type(type) {
 
   // loat image using stb library
   int img_width, img_height, chanel_count;
@@ -20,7 +19,7 @@ Texture::Texture(const char *image, TextureType type, GLuint slot)
       stbi_load(image, &img_width, &img_height, &chanel_count, 0);
 
   glGenTextures(1, &m_id);
-  bind();
+  glBindTexture(GL_TEXTURE_2D, m_id);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -49,13 +48,12 @@ Texture::Texture(const char *image, TextureType type, GLuint slot)
 
 Texture::Texture(Texture &&other) {
   m_id = std::move(other.m_id);
-  m_slot = std::move(other.m_slot);
   m_type = std::move(other.m_type);
   other.m_type = TextureType::INVALID;
 }
 
-void Texture::bind() const {
-  glActiveTexture(GL_TEXTURE0 + m_slot);
+void Texture::bind(GLuint unit) const {
+  glActiveTexture(GL_TEXTURE0 + unit);
   glBindTexture(GL_TEXTURE_2D, m_id);
 }
 
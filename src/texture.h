@@ -11,22 +11,20 @@ enum class TextureType { DIFFUSE, SPECULAR, INVALID };
 class Texture {
 public:
   Texture();
-  Texture(const char *image, TextureType type, GLuint slot);
+  Texture(const char *image, TextureType type);
   Texture(Texture &&other);
 
   ~Texture();
 
   TextureType type() const { return m_type; }
 
-  GLuint slot() const { return m_slot; }
-
-  void bind() const;
+  // bind to the given texture unit
+  void bind(GLuint unit) const;
   void unbind() const;
   void del();
 
 private:
   GLuint m_id;
-  GLuint m_slot;
   TextureType m_type;
 };
 
@@ -89,4 +89,64 @@ void print_glm_mat3(const glm::mat3 &m) {
   }
 }
 
+glm::mat4 compose_transformation(const glm::vec3 &translation,
+                                 const glm::quat &rotation,
+                                 const glm::vec3 &scaling) {
+  float xx = rotation.x * rotation.x;
+  float yy = rotation.y * rotation.y;
+  float zz = rotation.z * rotation.z;
+  float xy = rotation.x * rotation.y;
+  float xz = rotation.x * rotation.z;
+  float yz = rotation.y * rotation.z;
+  float wx = rotation.w * rotation.x;
+  float wy = rotation.w * rotation.y;
+  float wz = rotation.w * rotation.z;
+
+  // columns of the rotation matrix multiplied by the scaling
+  glm::mat4 m;
+  m[0][0] = (1.0f - 2.0f * (yy + zz)) * scaling.x;
+  m[0][1] = 2.0f * (xy + wz) * scaling.x;
+  m[0][2] = 2.0f * (xz - wy) * scaling.x;
+  m[0][3] = 0.0f;
+
+  m[1][0] = 2.0f * (xy - wz) * scaling.y;
+  m[1][1] = (1.0f - 2.0f * (xx + zz)) * scaling.y;
+  m[1][2] = 2.0f * (yz + wx) * scaling.y;
+  m[1][3] = 0.0f;
+
+  m[2][0] = 2.0f * (xz + wy) * scaling.z;
+  m[2][1] = 2.0f * (yz - wx) * scaling.z;
+  m[2][2] = (1.0f - 2.0f * (xx + yy)) * scaling.z;
+  m[2][3] = 0.0f;
+
+  m[3][0] = translation.x;
+  m[3][1] = translation.y;
+  m[3][2] = translation.z;
+  m[3][3] = 1.0f;
+  return m;
+}
+
+glm::mat4 get_affine_matrix(const glm::mat3x4 &rows) {
+  // rows are the columns of the transposed matrix, whose last column is
+  // filled from identity
+  return glm::transpose(glm::mat4(rows));
+}
+
+glm::mat2x4 convert_to_dual_quaternion(const glm::mat4 &transformation) {
+  // remove scaling from the rotation part
+  glm::mat3 rotation_matrix(glm::normalize(glm::vec3(transformation[0])),
+                            glm::normalize(glm::vec3(transformation[1])),
+                            glm::normalize(glm::vec3(transformation[2])));
+  glm::quat rotation = glm::normalize(glm::quat_cast(rotation_matrix));
+  glm::vec3 translation(transformation[3]);
+
+  // dual part is translation * rotation / 2
+  glm::quat dual =
+      glm::quat(0.0f, translation.x, translation.y, translation.z) * rotation *
+      0.5f;
+
+  return glm::mat2x4(glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w),
+                     glm::vec4(dual.x, dual.y, dual.z, dual.w));
+}
+
 } // namespace utility
@@ -8,6 +8,13 @@
 #include <glm/ext/vector_float3.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <glm/mat3x4.hpp>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define UTILITY_USE_SSE
+#endif
 
 namespace utility {
 void print_assimp_matrix(const aiMatrix4x4 &m);
@@ -21,6 +28,119 @@ glm::quat convert_to_glm_quat(const aiQuaternion &orientation);
 glm::mat3 create_glm_mat3_scaling(float x, float y);
 glm::mat3 create_glm_mat3_translation(float x, float y);
 glm::mat3 create_glm_mat3_rotation(float radians);
+
+// return translation * rotation * scaling built directly from the components
+// without multiplying three matrices, rotation has to be normalized
+glm::mat4 compose_transformation(const glm::vec3 &translation,
+                                 const glm::quat &rotation,
+                                 const glm::vec3 &scaling);
+
+// store columns of parent * child into columns, child has to be affine (last
+// row is 0 0 0 1)
+inline void multiply_affine_columns(const glm::mat4 &parent,
+                                    const glm::mat4 &child,
+                                    glm::vec4 (&columns)[4]) {
+#ifdef UTILITY_USE_SSE
+  // matrices are column major, every column of the result is a linear
+  // combination of parent's columns
+  __m128 p0 = _mm_loadu_ps(&parent[0][0]);
+  __m128 p1 = _mm_loadu_ps(&parent[1][0]);
+  __m128 p2 = _mm_loadu_ps(&parent[2][0]);
+  __m128 p3 = _mm_loadu_ps(&parent[3][0]);
+  for (int i = 0; i < 3; ++i) {
+    __m128 column = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(child[i][0])),
+                   _mm_mul_ps(p1, _mm_set1_ps(child[i][1]))),
+        _mm_mul_ps(p2, _mm_set1_ps(child[i][2])));
+    _mm_storeu_ps(&columns[i][0], column);
+  }
+  __m128 column = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(child[3][0])),
+                 _mm_mul_ps(p1, _mm_set1_ps(child[3][1]))),
+      _mm_add_ps(_mm_mul_ps(p2, _mm_set1_ps(child[3][2])), p3));
+  _mm_storeu_ps(&columns[3][0], column);
+#else
+  for (int i = 0; i < 3; ++i) {
+    columns[i] = parent[0] * child[i][0] + parent[1] * child[i][1] +
+                 parent[2] * child[i][2];
+  }
+  columns[3] = parent[0] * child[3][0] + parent[1] * child[3][1] +
+               parent[2] * child[3][2] + parent[3];
+#endif
+}
+
+// return parent * child, child has to be affine (last row is 0 0 0 1)
+// uses sse if available
+inline glm::mat4 multiply_affine(const glm::mat4 &parent,
+                                 const glm::mat4 &child) {
+  glm::vec4 columns[4];
+  multiply_affine_columns(parent, child, columns);
+  return glm::mat4(columns[0], columns[1], columns[2], columns[3]);
+}
+
+// bones palettes keep only the first three rows of the affine bone
+// transformations (the last row is always 0 0 0 1), stored as the columns of
+// a mat3x4, the shaders read them as mat3x4 as well
+// return the palette rows of parent * child, both have to be affine
+inline glm::mat3x4 multiply_affine_rows(const glm::mat4 &parent,
+                                        const glm::mat4 &child) {
+  glm::vec4 columns[4];
+  multiply_affine_columns(parent, child, columns);
+  glm::mat3x4 rows;
+#ifdef UTILITY_USE_SSE
+  __m128 c0 = _mm_loadu_ps(&columns[0][0]);
+  __m128 c1 = _mm_loadu_ps(&columns[1][0]);
+  __m128 c2 = _mm_loadu_ps(&columns[2][0]);
+  __m128 c3 = _mm_loadu_ps(&columns[3][0]);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  _mm_storeu_ps(&rows[0][0], c0);
+  _mm_storeu_ps(&rows[1][0], c1);
+  _mm_storeu_ps(&rows[2][0], c2);
+#else
+  for (int r = 0; r < 3; ++r) {
+    rows[r] = glm::vec4(columns[0][r], columns[1][r], columns[2][r],
+                        columns[3][r]);
+  }
+#endif
+  return rows;
+}
+
+// return the affine matrix of palette rows
+glm::mat4 get_affine_matrix(const glm::mat3x4 &rows);
+
+// evaluate nodes [begin, end) of a skeleton in one pass, nodes are in
+// depth-first order so a node's parent is always evaluated before it
+// global transformation of a node is its parent's global transformation times
+// its local transformation (identity for a node without a parent), palette
+// entry of a node with a bone is its global transformation times the bone's
+// offset
+// Node needs local_transformation and global_transformation members, Bone an
+// offset member, all of them affine
+template <typename Node, typename Bone>
+void concatenate_pose(std::vector<Node> &nodes, const std::vector<int> &parents,
+                      const std::vector<int> &node_bones,
+                      const std::vector<Bone> &bones,
+                      std::vector<glm::mat3x4> &palette, unsigned int begin,
+                      unsigned int end) {
+  for (unsigned int i = begin; i < end; ++i) {
+    auto &node = nodes[i];
+    node.global_transformation =
+        parents[i] < 0
+            ? glm::mat4(1.0f)
+            : multiply_affine(nodes[parents[i]].global_transformation,
+                              node.local_transformation);
+
+    int bone_index = node_bones[i];
+    if (bone_index >= 0) {
+      palette[bone_index] = multiply_affine_rows(node.global_transformation,
+                                                 bones[bone_index].offset);
+    }
+  }
+}
+// return dual quaternion of the rigid part of the transformation, first column
+// is the rotation and second the dual part, both as (x, y, z, w)
+// scaling is ignored
+glm::mat2x4 convert_to_dual_quaternion(const glm::mat4 &transformation);
 }; // namespace utility
 
 #endif /* _UTILITY_H_ */